@@ -1,8 +1,10 @@
 #include <mpi.h> // Import MPI lib
 #include <stdio.h>
-#include <time.h>
-#include <unistd.h>
+#include <iostream>
 #include <list>
+#include <vector>
+
+#include "mpi_workload.hpp"
 
 #define TABLE_RANK 0
 
@@ -14,7 +16,7 @@
 #define DEBUG 0
 
 void run_table_task(int, int);
-void run_philosopher_task(int);
+void run_philosopher_task(int, Workload&);
 
 int main(int argc, char** argv) {
     MPI_Init(&argc, &argv); // Initialize the MPI environment
@@ -23,11 +25,16 @@ int main(int argc, char** argv) {
     MPI_Comm_size(MPI_COMM_WORLD, &processes); // Get the number of processes
     MPI_Comm_rank(MPI_COMM_WORLD, &rank); // Get the rank of the process
 
+    WorkloadConfig config;
+    parse_workload_args(argc, argv, config);
+
+    Workload workload(config, rank);
     if (rank == TABLE_RANK) {
         run_table_task(rank, processes);
     } else {
-        run_philosopher_task(rank);
+        run_philosopher_task(rank, workload);
     }
+    report_stats(workload.stats, workload.elapsed(), "grab forks", TABLE_RANK);
 
     MPI_Finalize(); // Finalize the MPI environment.
 }
@@ -35,25 +42,27 @@ int main(int argc, char** argv) {
 void run_table_task(int my_rank, int num_procs)
 {
     if (DEBUG) printf("Hello from table task: %d \n",my_rank);
- 
+
     int buffer_in;
     int buffer_out;
     int philosopher;
+    int finished = 0;
     MPI_Status status;
 
     std::list<int> queue;
 
-    bool forks[num_procs-1];
-    for (int i =0; i<num_procs-1;i++){
-        forks[i] = true;
-    }
+    std::vector<bool> forks(num_procs-1, true);
 
-    while (true) {
+    while (finished < num_procs-1) {
         // Listen for incoming requests
         MPI_Recv(&buffer_in, 1, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
         philosopher = status.MPI_SOURCE;
 
-        if (status.MPI_TAG == GRAB_FORKS_REQUEST){
+        if (status.MPI_TAG == TERMINATE_TAG) {
+            if (DEBUG) std::cout << "Philosopher " << philosopher << " left the table" << std::endl;
+            finished++;
+        }
+        else if (status.MPI_TAG == GRAB_FORKS_REQUEST){
             if (DEBUG) std::cout << "Got GRAB_FORKS_REQUEST from " << status.MPI_SOURCE << std::endl;
             if (forks[philosopher%(num_procs-1)] == true && forks[philosopher-1] == true){ // Check if forks near philosopher are available
                 // if so make them unavailable for others
@@ -63,7 +72,6 @@ void run_table_task(int my_rank, int num_procs)
                 MPI_Send(&buffer_out, 1, MPI_INT, philosopher, GRAB_FORKS_PERMISSION_RESPONSE, MPI_COMM_WORLD);
                 if (DEBUG) std::cout << "Sent GRAB_FORKS_PERMISSION_RESPONSE to " << status.MPI_SOURCE << std::endl;
             } else {
-                if (DEBUG) std::cout << "Got GRAB_FORKS_REQUEST from " << status.MPI_SOURCE << std::endl;
                 if (DEBUG) std::cout << "There are no available forks for " << status.MPI_SOURCE << std::endl << "Adding " << philosopher << " to the queue" << std::endl;
                 // push philosopher to the waiting queue
                 queue.push_back(philosopher);
@@ -75,19 +83,19 @@ void run_table_task(int my_rank, int num_procs)
             forks[philosopher%(num_procs-1)] = true;
             forks[philosopher-1] = true;
             if (DEBUG) std::cout << "Put down forks from philosopher " << philosopher << std::endl;
-            if (!queue.empty()) { // serve waiting philosophers
-                if (DEBUG) std::cout << "Processing queue" << std::endl;
-                for (std::list<int>::iterator it = queue.begin(); it != queue.end(); it++){
-                    philosopher = *it;
-                    if (forks[philosopher%(num_procs-1)] == true && forks[philosopher-1] == true){ // If waiting philosopher have forks available grant them to him
-                        // Make forks unavailable to others
-                        forks[philosopher%(num_procs-1)] = false;
-                        forks[philosopher-1] = false;
-                        // notify philospher that now he has the forks
-                        MPI_Send(&buffer_out, 1, MPI_INT, philosopher, GRAB_FORKS_PERMISSION_RESPONSE, MPI_COMM_WORLD);
-                        if (DEBUG) std::cout << "Sent GRAB_FORKS_PERMISSION_RESPONSE to " << status.MPI_SOURCE << std::endl;
-                        it = queue.erase(it); // Philosopher is no longer waiting
-                    }
+            if (DEBUG && !queue.empty()) std::cout << "Processing queue" << std::endl;
+            for (std::list<int>::iterator it = queue.begin(); it != queue.end();){ // serve waiting philosophers
+                philosopher = *it;
+                if (forks[philosopher%(num_procs-1)] == true && forks[philosopher-1] == true){ // If waiting philosopher have forks available grant them to him
+                    // Make forks unavailable to others
+                    forks[philosopher%(num_procs-1)] = false;
+                    forks[philosopher-1] = false;
+                    // notify philospher that now he has the forks
+                    MPI_Send(&buffer_out, 1, MPI_INT, philosopher, GRAB_FORKS_PERMISSION_RESPONSE, MPI_COMM_WORLD);
+                    if (DEBUG) std::cout << "Sent GRAB_FORKS_PERMISSION_RESPONSE to " << philosopher << std::endl;
+                    it = queue.erase(it); // Philosopher is no longer waiting
+                } else {
+                    it++;
                 }
             }
         }
@@ -95,31 +103,29 @@ void run_table_task(int my_rank, int num_procs)
     }
 }
 
-void run_philosopher_task(int my_rank)
+void run_philosopher_task(int my_rank, Workload& workload)
 {
     if (DEBUG) printf("Hello from philosopher task: %d\n",my_rank);
-    srand(time(NULL) + my_rank);
     int buffer_in;
     int buffer_out;
     MPI_Status status;
-    int seconds;
 
-    while (true)
-    {   
-        seconds = rand() % 10; 
-        printf("Philosopher %d is thinking for %d seconds\n", my_rank, seconds);
-        sleep(seconds); // Think
-        printf("Philosopher %d is waiting for forks\n", my_rank);
+    while (workload.next())
+    {
+        if (workload.verbose()) printf("Philosopher %d is thinking\n", my_rank);
+        workload.think(); // Think
+        if (workload.verbose()) printf("Philosopher %d is waiting for forks\n", my_rank);
 
         // Grab forks
+        workload.begin();
         MPI_Send(&buffer_out, 1,MPI_INT, TABLE_RANK, GRAB_FORKS_REQUEST, MPI_COMM_WORLD);
         MPI_Recv(&buffer_in, 1, MPI_INT, TABLE_RANK, GRAB_FORKS_PERMISSION_RESPONSE, MPI_COMM_WORLD, &status);
+        workload.end();
 
-        seconds = rand() % 10; 
-        printf("Philosopher %d is eating for %d seconds\n", my_rank, seconds);
-        sleep(seconds); // Eat
-        printf("Philosopher %d is done eating\n", my_rank);
+        if (workload.verbose()) printf("Philosopher %d is eating\n", my_rank);
+        workload.work(); // Eat
+        if (workload.verbose()) printf("Philosopher %d is done eating\n", my_rank);
         MPI_Send(&buffer_out, 1,MPI_INT, TABLE_RANK, PUT_DOWN_FORKS_REQUEST, MPI_COMM_WORLD);
     }
-    
+    send_termination(TABLE_RANK);
 }
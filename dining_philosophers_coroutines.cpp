@@ -0,0 +1,594 @@
+// Dining philosophers as C++20 coroutines, millions of philosophers in one process.
+// Every philosopher is a coroutine and taking a fork is an awaitable, a waiting philosopher is parked in the queue of the fork
+// and resumed by the neighbour that puts the fork down. The coroutines run on a pool of worker threads with work stealing:
+// every worker has its own deque, takes from its back and steals from the front of a random victim when it is empty.
+// Delays run in virtual time by default: the workers run all philosophers ready at the current time, then the clock
+// jumps to the next delay that ends (time steps of the workers synchronized by a barrier). With --time real the delays
+// are real microseconds. At the end meals per second, the waiting times, the starvation and the scheduler costs are printed.
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "workload.hpp"
+
+/**
+ * Order in which a philosopher takes its forks
+ * @param ORDERED: the lower numbered fork first (resource hierarchy), no cycle of waiting philosophers
+ * @param EVEN_ODD: even philosophers take the left fork first, odd ones the right fork first
+ * @param BACKOFF: take the left fork, try the right one, if it is taken put the left one down and wait a random,
+ *                 growing time before the next attempt
+ */
+enum class ForkPolicy {
+    ORDERED = 0,
+    EVEN_ODD = 1,
+    BACKOFF = 2,
+};
+
+// Backoff delays of the BACKOFF policy are drawn from 1..2^(attempt + 1) microseconds (attempt counted from 0), capped at this many
+#define MAX_BACKOFF_US 1024
+
+// Spin lock of a deque or a fork, held for a few instructions only
+class SpinLock {
+   public:
+    void lock() {
+        while (flag.exchange(true, std::memory_order_acquire)) {
+            while (flag.load(std::memory_order_relaxed)) {
+            }
+        }
+    }
+
+    void unlock() { flag.store(false, std::memory_order_release); }
+
+   private:
+    std::atomic<bool> flag{false};
+};
+
+/**
+ * Histogram of waiting times in microseconds, 8 buckets per power of two (relative error below 12.5%),
+ * so the percentiles of billions of meals take a few kilobytes
+ */
+class WaitHistogram {
+   public:
+    WaitHistogram() : counts(64 * 8, 0) {}
+
+    void add(uint64_t us) {
+        counts[bucket(us)]++;
+        total++;
+    }
+
+    void merge(const WaitHistogram &other) {
+        for (size_t i = 0; i < counts.size(); i++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+    }
+
+    /**
+     * Upper bound of the p-th percentile
+     * @param p percentile in [0, 100]
+     */
+    uint64_t percentile(double p) const {
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(p / 100.0 * total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return upper_bound(i);
+            }
+        }
+        return 0;
+    }
+
+   private:
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+
+    static size_t bucket(uint64_t us) {
+        if (us < 8) {
+            return us;
+        }
+        int exponent = 63 - __builtin_clzll(us);
+        return (exponent - 2) * 8 + ((us >> (exponent - 3)) & 7);
+    }
+
+    static uint64_t upper_bound(size_t i) {
+        if (i < 8) {
+            return i;
+        }
+        int exponent = i / 8 + 2;
+        return ((8 + i % 8 + 1) << (exponent - 3)) - 1;
+    }
+};
+
+/**
+ * Coroutine of a philosopher, started by the scheduler and destroyed when it returns
+ */
+struct Philosopher {
+    struct promise_type {
+        Philosopher get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+class Simulation;
+
+// Waiting philosopher, lives in the coroutine frame while it waits, so the queue of a fork allocates nothing
+struct ForkWaiter {
+    std::coroutine_handle<> handle;
+    ForkWaiter *next = nullptr;
+};
+
+struct Fork {
+    SpinLock lock;
+    bool taken = false;
+    ForkWaiter *head = nullptr;  // Waiting philosophers, first come first served
+    ForkWaiter *tail = nullptr;
+
+    bool try_take() {
+        lock.lock();
+        bool free = !taken;
+        taken = true;
+        lock.unlock();
+        return free;
+    }
+};
+
+/**
+ * Awaitable taking a fork, suspends the philosopher until the fork is handed to it
+ */
+struct ForkAcquire {
+    Fork &fork;
+    ForkWaiter waiter;
+
+    bool await_ready() { return fork.try_take(); }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        waiter.handle = handle;
+        fork.lock.lock();
+        if (!fork.taken) {
+            fork.taken = true;
+            fork.lock.unlock();
+            return false;  // put down in the meantime, continue without suspending
+        }
+        if (fork.tail) {
+            fork.tail->next = &waiter;
+        } else {
+            fork.head = &waiter;
+        }
+        fork.tail = &waiter;
+        fork.lock.unlock();
+        return true;  // the owner may resume the philosopher on any worker from now on
+    }
+
+    void await_resume() {}
+};
+
+/**
+ * Awaitable delay of a philosopher, in virtual or real microseconds
+ */
+struct Delay {
+    Simulation &simulation;
+    long long us;
+
+    bool await_ready() { return us <= 0; }
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+    void await_resume() {}
+};
+
+/**
+ * Delays of the coroutines of a worker as a calendar: the coroutines are grouped by the end of their delay
+ * and only the distinct ends are kept in a heap. The delays are whole microseconds, so many end at the same time
+ * and a delay costs a hash insert instead of a push into a heap of millions of coroutines.
+ */
+class Timers {
+   public:
+    void add(long long time, std::coroutine_handle<> handle) {
+        std::vector<std::coroutine_handle<>> &slot = slots[time];
+        if (slot.empty()) {
+            ends.push(time);
+        }
+        slot.push_back(handle);
+    }
+
+    bool empty() const { return ends.empty(); }
+
+    // End of the first delay, the calendar must not be empty
+    long long next() const { return ends.top(); }
+
+    /**
+     * Move the coroutines whose delays end first to the back of the deque
+     * @return the number of coroutines
+     */
+    size_t pop_next(std::deque<std::coroutine_handle<>> &ready) {
+        auto slot = slots.find(ends.top());
+        ends.pop();
+        size_t count = slot->second.size();
+        ready.insert(ready.end(), slot->second.begin(), slot->second.end());
+        slots.erase(slot);
+        return count;
+    }
+
+   private:
+    std::unordered_map<long long, std::vector<std::coroutine_handle<>>> slots;
+    std::priority_queue<long long, std::vector<long long>, std::greater<long long>> ends;
+};
+
+/**
+ * Worker thread of the scheduler, aligned to its own cache lines
+ */
+struct alignas(64) Worker {
+    SpinLock lock;
+    std::deque<std::coroutine_handle<>> ready;
+    Timers timers;  // Delays started on this worker
+    std::mt19937_64 gen;
+    WaitHistogram waits;
+    uint64_t resumes = 0;
+    uint64_t steals = 0;
+    double busy = 0.0;  // Seconds spent in the coroutines
+};
+
+thread_local Worker *current_worker = nullptr;
+
+/**
+ * The table, the scheduler and the statistics
+ */
+class Simulation {
+   public:
+    Simulation(const WorkloadConfig &config, int num_philosophers, int num_workers, ForkPolicy policy, bool virtual_time)
+        : config(config), num_philosophers(num_philosophers), policy(policy), virtual_time(virtual_time),
+          forks(num_philosophers), meals(num_philosophers, 0), max_wait(num_philosophers, 0), workers(num_workers) {
+        for (int w = 0; w < num_workers; w++) {
+            workers[w].gen.seed(config.seed + w);
+        }
+    }
+
+    /**
+     * Run all philosophers until they had their meals (or the duration passed)
+     * @return the wall time in seconds
+     */
+    double run() {
+        // The philosophers are dealt to the workers in blocks, neighbours share forks and mostly a worker
+        for (int i = 0; i < num_philosophers; i++) {
+            Worker &worker = workers[(size_t)i * workers.size() / num_philosophers];
+            worker.ready.push_back(philosopher(i).handle);
+            pending.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        real_start = start;
+        auto on_step = [this]() noexcept { next_step(); };
+        std::barrier<decltype(on_step)> step(workers.size(), on_step);
+        std::function<void()> end_step = [&step]() { step.arrive_and_wait(); };
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < workers.size(); w++) {
+            threads.emplace_back([this, w, &end_step]() { work(w, end_step); });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(double elapsed) const {
+        WaitHistogram waits;
+        uint64_t resumes = 0, steals = 0;
+        double busy = 0;
+        for (const Worker &worker : workers) {
+            waits.merge(worker.waits);
+            resumes += worker.resumes;
+            steals += worker.steals;
+            busy += worker.busy;
+        }
+        // Starvation: the spread of the meals and Jain's fairness index (sum x)^2 / (n sum x^2), 1 if all ate the same
+        uint64_t total = 0, least = UINT64_MAX, most = 0, longest = 0;
+        double squares = 0;
+        for (int i = 0; i < num_philosophers; i++) {
+            total += meals[i];
+            least = std::min<uint64_t>(least, meals[i]);
+            most = std::max<uint64_t>(most, meals[i]);
+            longest = std::max<uint64_t>(longest, max_wait[i]);
+            squares += (double)meals[i] * meals[i];
+        }
+        double fairness = squares > 0 ? (double)total * total / (num_philosophers * squares) : 1.0;
+
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "meals: philosophers=" << num_philosophers << " meals=" << total << " time=" << elapsed << "s"
+                  << " throughput=" << (elapsed > 0 ? total / elapsed : 0.0) << " meals/s";
+        if (virtual_time) {
+            std::cout << std::setprecision(6) << " virtual time=" << now_us / 1e6 << "s" << std::setprecision(2) << " (" << (now_us > 0 ? total / (now_us / 1e6) : 0.0) << " meals per virtual s)";
+        }
+        std::cout << std::endl;
+        std::cout << "wait[us]: p50=" << waits.percentile(50) << " p90=" << waits.percentile(90) << " p99=" << waits.percentile(99)
+                  << " max=" << longest << std::endl;
+        std::cout << "starvation: least meals=" << least << " most meals=" << most << " fairness=" << std::setprecision(4) << fairness
+                  << std::setprecision(2) << std::endl;
+        // Everything but the time in the coroutines is scheduling (deques, stealing, timers, the time steps and idling)
+        double capacity = elapsed * workers.size();
+        std::cout << "scheduler: workers=" << workers.size() << " resumes=" << resumes << " steals=" << steals;
+        if (virtual_time) {
+            std::cout << " steps=" << steps;
+        }
+        std::cout << " overhead=" << (resumes > 0 ? (capacity - busy) * 1e9 / resumes : 0.0) << " ns/resume"
+                  << " (" << (capacity > 0 ? 100.0 * (capacity - busy) / capacity : 0.0) << "% of the worker time)" << std::endl;
+        if (finished < num_philosophers) {
+            std::cout << "deadlock: " << num_philosophers - finished << " philosophers wait for forks forever" << std::endl;
+        }
+    }
+
+    /**
+     * Current time in microseconds, virtual or since the start
+     */
+    long long now() const {
+        if (virtual_time) {
+            return now_us;
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - real_start).count();
+    }
+
+    Delay sleep(long long us) { return Delay{*this, us}; }
+
+    void start_timer(long long us, std::coroutine_handle<> handle) { current_worker->timers.add(now() + us, handle); }
+
+   private:
+    const WorkloadConfig &config;
+    int num_philosophers;
+    ForkPolicy policy;
+    bool virtual_time;
+    std::vector<Fork> forks;
+    std::vector<uint32_t> meals;     // Written only by the coroutine of the philosopher
+    std::vector<uint32_t> max_wait;  // Longest wait for the forks of every philosopher in microseconds
+    std::vector<Worker> workers;
+
+    std::atomic<long long> pending{0};  // Coroutines in the deques or running
+    std::atomic<int> finished{0};
+    std::atomic<bool> done{false};
+    long long now_us = 0;  // Virtual time, changed only between the time steps
+    uint64_t steps = 0;
+    std::chrono::steady_clock::time_point real_start;
+
+    Philosopher philosopher(int id) {
+        int left = id, right = (id + 1) % num_philosophers;
+        int first = std::min(left, right), second = std::max(left, right);
+        if (policy != ForkPolicy::ORDERED) {
+            first = left;
+            second = right;
+            if (policy == ForkPolicy::EVEN_ODD && id % 2 == 1) {
+                std::swap(first, second);
+            }
+        }
+
+        for (long long meal = 0; config.duration > 0 ? now() < config.duration * 1e6 : meal < config.num_ops; meal++) {
+            co_await sleep(config.think.sample(current_worker->gen));
+
+            long long hungry = now();
+            if (policy == ForkPolicy::BACKOFF) {
+                for (int attempt = 0;; attempt = std::min(attempt + 1, 10)) {
+                    co_await ForkAcquire{forks[first], {}};
+                    if (forks[second].try_take()) {
+                        break;
+                    }
+                    release(first);
+                    std::uniform_int_distribution<long long> backoff(1, std::min<long long>(2ll << attempt, MAX_BACKOFF_US));
+                    co_await sleep(backoff(current_worker->gen));
+                }
+            } else {
+                co_await ForkAcquire{forks[first], {}};
+                co_await ForkAcquire{forks[second], {}};
+            }
+            long long wait = now() - hungry;
+            current_worker->waits.add(wait);
+            max_wait[id] = std::max<uint32_t>(max_wait[id], std::min<long long>(wait, UINT32_MAX));
+
+            co_await sleep(config.work.sample(current_worker->gen));
+            meals[id]++;
+            release(second);
+            release(first);
+        }
+        finished.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Put a fork down, the first waiting philosopher gets it and is scheduled on this worker
+     */
+    void release(int i) {
+        Fork &fork = forks[i];
+        fork.lock.lock();
+        ForkWaiter *waiter = fork.head;
+        if (waiter) {
+            fork.head = waiter->next;
+            if (!fork.head) {
+                fork.tail = nullptr;
+            }
+        } else {
+            fork.taken = false;
+        }
+        fork.lock.unlock();
+        if (waiter) {
+            schedule(waiter->handle);
+        }
+    }
+
+    void schedule(std::coroutine_handle<> handle) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        current_worker->lock.lock();
+        current_worker->ready.push_back(handle);
+        current_worker->lock.unlock();
+    }
+
+    std::coroutine_handle<> take(size_t w) {
+        Worker &worker = workers[w];
+        worker.lock.lock();
+        std::coroutine_handle<> handle;
+        if (!worker.ready.empty()) {
+            handle = worker.ready.back();
+            worker.ready.pop_back();
+        }
+        worker.lock.unlock();
+        if (handle || workers.size() == 1) {
+            return handle;
+        }
+        // Steal the oldest coroutine of a random victim, the owner keeps the recently woken ones that are warm in its cache
+        std::uniform_int_distribution<size_t> pick(0, workers.size() - 2);
+        size_t v = pick(worker.gen);
+        Worker &victim = workers[v >= w ? v + 1 : v];
+        victim.lock.lock();
+        if (!victim.ready.empty()) {
+            handle = victim.ready.front();
+            victim.ready.pop_front();
+            worker.steals++;
+        }
+        victim.lock.unlock();
+        return handle;
+    }
+
+    /**
+     * Loop of a worker thread
+     * @param w the index of the worker
+     * @param end_step waits for the other workers at the end of a time step of the virtual time
+     */
+    void work(size_t w, const std::function<void()> &end_step);
+
+    /**
+     * End of a time step of the virtual time, runs on one worker while the others wait:
+     * the clock jumps to the first delay that ends and all the delays ending then are made ready
+     */
+    void next_step() {
+        long long next = LLONG_MAX;
+        for (Worker &worker : workers) {
+            if (!worker.timers.empty()) {
+                next = std::min(next, worker.timers.next());
+            }
+        }
+        if (next == LLONG_MAX) {
+            done = true;  // everybody finished, or the rest waits for forks that are never put down
+            return;
+        }
+        now_us = next;
+        steps++;
+        for (Worker &worker : workers) {
+            if (!worker.timers.empty() && worker.timers.next() == next) {
+                pending.fetch_add(worker.timers.pop_next(worker.ready), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    friend struct Delay;
+};
+
+void Delay::await_suspend(std::coroutine_handle<> handle) { simulation.start_timer(us, handle); }
+
+void Simulation::work(size_t w, const std::function<void()> &end_step) {
+    Worker &worker = workers[w];
+    current_worker = &worker;
+    while (!done.load(std::memory_order_relaxed)) {
+        std::coroutine_handle<> handle = take(w);
+        if (handle) {
+            auto start = std::chrono::steady_clock::now();
+            handle.resume();
+            worker.busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            worker.resumes++;
+            pending.fetch_sub(1, std::memory_order_release);
+            continue;
+        }
+        // Real time: make the delays of this worker that ended ready, only this worker pops its timers,
+        // so it must do so even while the others are busy
+        long long now_real = virtual_time ? 0 : now();
+        bool woke = false;
+        while (!virtual_time && !worker.timers.empty() && worker.timers.next() <= now_real) {
+            worker.lock.lock();
+            pending.fetch_add(worker.timers.pop_next(worker.ready), std::memory_order_relaxed);
+            worker.lock.unlock();
+            woke = true;
+        }
+        if (woke) {
+            continue;
+        }
+        if (pending.load(std::memory_order_acquire) > 0) {
+            std::this_thread::yield();  // others still run coroutines that may wake some up or can be stolen
+            continue;
+        }
+        if (virtual_time) {
+            // Nothing is ready or running, no coroutine can become ready before the clock moves
+            end_step();
+            continue;
+        }
+        if (finished.load(std::memory_order_relaxed) == num_philosophers) {
+            done = true;
+            break;
+        }
+        // No delay of this worker ended, sleep a little
+        std::this_thread::sleep_for(std::chrono::microseconds(worker.timers.empty() ? 50 : std::min(50ll, worker.timers.next() - now_real)));
+    }
+}
+
+int main(int argc, char **argv) {
+    // The string flags of this demo, the rest are the workload flags
+    std::string policy_name = "ordered";
+    std::string time_name = "virtual";
+    std::vector<char *> workload_args = {argv[0]};
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--help" || flag == "-h") {
+            std::cout << "Usage: " << argv[0] << " [--philosophers <n>] [--workers <n>] [--policy ordered|even-odd|backoff]\n"
+                      << "       [--time virtual|real] [--ops <n>] [--duration <seconds>] [--think <spec>] [--work <spec>]\n"
+                      << "       [--seed <n>] [--verbose]\n"
+                      << "A delay <spec> is const:<us>, uniform:<min>:<max> or exp:<mean>" << std::endl;
+            return 0;
+        }
+        if ((flag == "--policy" || flag == "--time") && i + 1 < argc) {
+            (flag == "--policy" ? policy_name : time_name) = argv[++i];
+        } else {
+            workload_args.push_back(argv[i]);
+        }
+    }
+
+    WorkloadConfig config;
+    int num_philosophers = 1000;
+    int num_workers = std::max(1u, std::thread::hardware_concurrency());
+    parse_workload_args(workload_args.size(), workload_args.data(), config, {{"--philosophers", &num_philosophers}, {"--workers", &num_workers}});
+
+    ForkPolicy policy;
+    if (policy_name == "ordered") {
+        policy = ForkPolicy::ORDERED;
+    } else if (policy_name == "even-odd") {
+        policy = ForkPolicy::EVEN_ODD;
+    } else if (policy_name == "backoff") {
+        policy = ForkPolicy::BACKOFF;
+    } else {
+        throw std::runtime_error("Unknown policy " + policy_name);
+    }
+    if (time_name != "virtual" && time_name != "real") {
+        throw std::runtime_error("Unknown time " + time_name);
+    }
+    if (num_philosophers < 2 || num_workers < 1) {
+        throw std::runtime_error("At least 2 philosophers and 1 worker are needed");
+    }
+
+    Simulation simulation(config, num_philosophers, num_workers, policy, time_name == "virtual");
+    double elapsed = simulation.run();
+    simulation.report(elapsed);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+/**
+ * Bounded cache of the costs of solutions, indexed by the hash of the solution (e.g. Permutation::hash).
+ * Every hash has one slot, a new cost replaces the old one, so the memory is fixed at 16 bytes per entry.
+ * The cache is lock-free and can be shared by the threads of the speculative annealing and of the thread backend:
+ * a slot stores the cost and the xor of the hash with the cost in two relaxed atomics, a reader checks that they
+ * still match its hash, so an entry torn by a concurrent writer is a miss instead of a wrong cost.
+ * Two solutions with the same 64 bit hash share a cost, which is negligible for the numbers of solutions visited.
+ */
+class CostCache {
+   public:
+    /**
+     * @param entries number of entries, rounded up to a power of two
+     */
+    explicit CostCache(size_t entries) {
+        size_t size = 1;
+        while (size < entries) {
+            size *= 2;
+        }
+        mask = size - 1;
+        slots = std::vector<Slot>(size);
+    }
+
+    /**
+     * Look up the cost of a solution
+     * @param hash the hash of the solution
+     * @param cost set to the cached cost on a hit
+     * @return whether the cost was cached
+     */
+    bool find(uint64_t hash, double &cost) const {
+        const Slot &slot = slots[hash & mask];
+        uint64_t bits = slot.cost.load(std::memory_order_relaxed);
+        if ((slot.check.load(std::memory_order_relaxed) ^ bits) != hash) {
+            return false;
+        }
+        std::memcpy(&cost, &bits, sizeof(double));
+        return !std::isnan(cost);  // empty slots hold NaN
+    }
+
+    /**
+     * Store the cost of a solution
+     * @param hash the hash of the solution
+     * @param cost the cost
+     */
+    void store(uint64_t hash, double cost) {
+        Slot &slot = slots[hash & mask];
+        uint64_t bits;
+        std::memcpy(&bits, &cost, sizeof(double));
+        slot.cost.store(bits, std::memory_order_relaxed);
+        slot.check.store(hash ^ bits, std::memory_order_relaxed);
+    }
+
+    size_t size() const { return slots.size(); }
+
+   private:
+    struct Slot {
+        std::atomic<uint64_t> check{empty_bits()};
+        std::atomic<uint64_t> cost{empty_bits()};
+    };
+
+    size_t mask;
+    std::vector<Slot> slots;
+
+    static uint64_t empty_bits() {
+        double nan = std::numeric_limits<double>::quiet_NaN();
+        uint64_t bits;
+        std::memcpy(&bits, &nan, sizeof(double));
+        return bits;
+    }
+};
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "island_model.hpp"
+
+#ifndef NO_EXCHANGE_PERIOD
+#define NO_EXCHANGE_PERIOD -1
+#endif
+#ifndef NO_TIME_LIMIT
+#define NO_TIME_LIMIT -1
+#endif
+
+/**
+ * Crossover operators of permutations
+ * @param ORDER: OX, a segment of the first parent, the rest in the order of the second parent
+ * @param PARTIALLY_MAPPED: PMX, a segment of the first parent, the rest from the second parent repaired through the mapping of the segment
+ * @param CYCLE: CX, the cycles of the positions alternately from the first and the second parent, every value keeps the position it has in a parent
+ */
+enum class Crossover {
+    ORDER = 0,
+    PARTIALLY_MAPPED = 1,
+    CYCLE = 2,
+};
+
+/**
+ * Get a crossover operator by name
+ * @param name ox, pmx or cx
+ */
+inline Crossover parse_crossover(const std::string &name) {
+    if (name == "ox") {
+        return Crossover::ORDER;
+    } else if (name == "pmx") {
+        return Crossover::PARTIALLY_MAPPED;
+    } else if (name == "cx") {
+        return Crossover::CYCLE;
+    }
+    throw std::runtime_error("Unknown crossover " + name);
+}
+
+/**
+ * Hybrid genetic algorithm over permutations (memetic algorithm).
+ * The genes of the population are kept in one contiguous array, a row per individual, and unpacked
+ * into a solution only for the evaluation, so the existing cost functions are reused.
+ * Every generation the children are made by binary tournament selection and crossover, a share of them
+ * is improved by a short annealing (or a local search at temperature 0) and all of them are evaluated
+ * in parallel; the best distinct individuals of the parents and the children survive.
+ * With an island model every process is an island, its best individuals migrate to the neighbours
+ * and a migrant replaces the worst individual.
+ * @tparam T the type of the solution, a permutation providing size, data, unpack and value_type (e.g. Permutation)
+ */
+template <typename T>
+class GeneticSolver {
+   public:
+    typedef typename T::value_type gene_t;
+
+    /**
+     * Constructor
+     * @param n size of the permutations
+     * @param population_size number of individuals of the island
+     * @param cost the cost function, called from multiple threads
+     * @param random_solution the generator of the initial individuals
+     * @param crossover the crossover operator
+     * @param on_new_best_solution called with every new best solution of the island
+     */
+    GeneticSolver(int n, int population_size, std::function<double(const T &)> cost, std::function<T()> random_solution, Crossover crossover, std::function<void(T &, double)> on_new_best_solution)
+        : n(n), population_size(std::max(2, population_size)), cost(cost), random_solution(random_solution), crossover(crossover), on_new_solution(on_new_best_solution) {}
+
+    /**
+     * Improve the children by a short annealing
+     * @param random_move makes a random move of a solution in place, with the generator of the thread
+     * @param undo_move undoes the last move
+     * @param steps number of moves tried per child
+     * @param temperature temperature of the acceptance test, 0 accepts only moves that do not make the solution worse (local search)
+     * @param rate probability that a child is improved
+     */
+    void set_annealing_mutation(std::function<void(T &, std::mt19937 &)> random_move, std::function<void(T &)> undo_move, int steps, double temperature, double rate) {
+        this->random_move = random_move;
+        this->undo_move = undo_move;
+        mutation_steps = steps;
+        mutation_temperature = temperature;
+        mutation_rate = rate;
+    }
+
+    /**
+     * Use the island model for the communication between processes, a process is a single island without it
+     * @param island_model the island model, must outlive the calls to solve
+     */
+    void set_island_model(IslandModel<T> *island_model) { this->island_model = island_model; }
+
+    /**
+     * Set the number of threads improving and evaluating the children, 1 by default
+     */
+    void set_threads(int num_threads) { this->num_threads = std::max(1, num_threads); }
+
+    /**
+     * Seed the selection, the crossover and the mutation, a random seed is used by default
+     * @param seed the seed, should differ between processes
+     */
+    void set_seed(unsigned seed) {
+        this->seed = seed;
+        seeded = true;
+    }
+
+    /**
+     * Solve the problem
+     * @param num_generations the number of generations
+     * @param migration_period number of generations between the migrations
+     * @param time_limit the time limit in seconds
+     * @return a pair of the best solution and the cost of the best solution
+     */
+    std::pair<T, double> solve(int num_generations, int migration_period = NO_EXCHANGE_PERIOD, double time_limit = NO_TIME_LIMIT) {
+        std::mt19937 gen(seeded ? seed : std::random_device()());
+        if (migration_period == NO_EXCHANGE_PERIOD) {
+            migration_period = num_generations;
+        }
+
+        // Parents in the first rows, children in the rest
+        genes.assign((size_t)2 * population_size * n, 0);
+        costs.assign(2 * population_size, 0.0);
+        for (int i = 0; i < population_size; i++) {
+            T individual = random_solution();
+            std::copy(individual.data(), individual.data() + n, row(i));
+        }
+        evaluate(0, population_size, std::vector<unsigned>(population_size, 0), false);
+        int best = std::min_element(costs.begin(), costs.begin() + population_size) - costs.begin();
+        T best_solution = unpacked(best);
+        double best_cost = costs[best];
+        on_new_solution(best_solution, best_cost);
+
+        double start = Communicator::wtime();
+        for (int generation = 0; generation < num_generations; generation++) {
+            if (time_limit != NO_TIME_LIMIT && Communicator::wtime() - start > time_limit) {
+                break;
+            }
+
+            // Selection and crossover are cheap and use the generator of the process, so a run does not depend on the number of threads
+            std::vector<unsigned> mutation_seeds(population_size, 0);
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            for (int i = 0; i < population_size; i++) {
+                int a = tournament(gen), b = tournament(gen);
+                cross(row(a), row(b), row(population_size + i), gen);
+                if (random_move && uniform(gen) < mutation_rate) {
+                    mutation_seeds[i] = gen() | 1u;  // 0 means no mutation
+                }
+            }
+            evaluate(population_size, population_size, mutation_seeds, true);
+            survive();
+
+            if (costs[0] < best_cost) {
+                best_cost = costs[0];
+                best_solution = unpacked(0);
+                on_new_solution(best_solution, best_cost);
+            }
+
+            if (island_model != nullptr) {
+                island_model->offer(best_solution, best_cost);
+                // A migrant takes the place of the worst individual if the policy accepts it
+                int worst = population_size - 1;
+                T migrant = unpacked(worst);
+                double migrant_cost = costs[worst];
+                if (island_model->immigrate(migrant, migrant_cost)) {
+                    std::copy(migrant.data(), migrant.data() + n, row(worst));
+                    costs[worst] = migrant_cost;
+                    if (migrant_cost < best_cost) {
+                        best_cost = migrant_cost;
+                        best_solution = migrant;
+                    }
+                }
+                if ((generation + 1) % migration_period == 0) {
+                    island_model->emigrate();
+                }
+            }
+        }
+
+        if (island_model != nullptr) {
+            island_model->finish();
+        }
+
+        return {best_solution, best_cost};
+    }
+
+   private:
+    int n;
+    int population_size;
+    std::function<double(const T &)> cost;
+    std::function<T()> random_solution;
+    Crossover crossover;
+    std::function<void(T &, double)> on_new_solution;
+
+    std::function<void(T &, std::mt19937 &)> random_move;
+    std::function<void(T &)> undo_move;
+    int mutation_steps = 0;
+    double mutation_temperature = 0;
+    double mutation_rate = 0;
+
+    IslandModel<T> *island_model = nullptr;
+    int num_threads = 1;
+    unsigned seed = 0;
+    bool seeded = false;
+
+    std::vector<gene_t> genes;  // Row i holds the permutation of individual i
+    std::vector<double> costs;  // Cost of every row
+    std::vector<int> position;  // Buffers of the crossover
+    std::vector<char> taken;
+
+    gene_t *row(int i) { return genes.data() + (size_t)i * n; }
+
+    T unpacked(int i) {
+        T solution(n);
+        solution.unpack(row(i));
+        return solution;
+    }
+
+    /**
+     * Binary tournament among the parents
+     */
+    int tournament(std::mt19937 &gen) const {
+        std::uniform_int_distribution<int> pick(0, population_size - 1);
+        int a = pick(gen), b = pick(gen);
+        return costs[a] <= costs[b] ? a : b;
+    }
+
+    /**
+     * Improve (if the seed is not 0) and evaluate the rows first..first+count-1 in parallel
+     */
+    void evaluate(int first, int count, const std::vector<unsigned> &mutation_seeds, bool mutate) {
+#pragma omp parallel num_threads(num_threads) if (num_threads > 1)
+        {
+            T solution(n);
+#pragma omp for schedule(dynamic)
+            for (int i = 0; i < count; i++) {
+                solution.unpack(row(first + i));
+                double solution_cost = cost(solution);
+                if (mutate && mutation_seeds[i] != 0) {
+                    solution_cost = anneal(solution, solution_cost, mutation_seeds[i]);
+                    std::copy(solution.data(), solution.data() + n, row(first + i));
+                }
+                costs[first + i] = solution_cost;
+            }
+        }
+    }
+
+    /**
+     * Short annealing at a constant temperature, returns the cost of the improved solution
+     */
+    double anneal(T &solution, double solution_cost, unsigned seed) const {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        for (int step = 0; step < mutation_steps; step++) {
+            random_move(solution, gen);
+            double candidate_cost = cost(solution);
+            double delta = candidate_cost - solution_cost;
+            if (delta <= 0 || (mutation_temperature > 0 && uniform(gen) < std::exp(-delta / mutation_temperature))) {
+                solution_cost = candidate_cost;
+            } else {
+                undo_move(solution);
+            }
+        }
+        return solution_cost;
+    }
+
+    /**
+     * Keep the best distinct individuals of the parents and the children in the first rows, sorted by cost
+     */
+    void survive() {
+        std::vector<int> order(2 * population_size);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return costs[a] < costs[b]; });
+        std::vector<int> kept;
+        std::vector<int> duplicates;
+        for (int i : order) {
+            // The kept rows are sorted by cost, a duplicate can only be among the last ones with the same cost
+            bool duplicate = false;
+            for (int k = (int)kept.size() - 1; !duplicate && k >= 0 && costs[kept[k]] == costs[i]; k--) {
+                duplicate = std::equal(row(i), row(i) + n, row(kept[k]));
+            }
+            if (duplicate) {
+                duplicates.push_back(i);
+            } else if ((int)kept.size() < population_size) {
+                kept.push_back(i);
+            }
+        }
+        // Duplicates only fill the population if there are not enough distinct individuals
+        for (size_t i = 0; (int)kept.size() < population_size; i++) {
+            kept.push_back(duplicates[i]);
+        }
+
+        std::vector<gene_t> survivors((size_t)population_size * n);
+        std::vector<double> survivor_costs(population_size);
+        for (int i = 0; i < population_size; i++) {
+            std::copy(row(kept[i]), row(kept[i]) + n, survivors.begin() + (size_t)i * n);
+            survivor_costs[i] = costs[kept[i]];
+        }
+        std::copy(survivors.begin(), survivors.end(), genes.begin());
+        std::copy(survivor_costs.begin(), survivor_costs.end(), costs.begin());
+    }
+
+    void cross(const gene_t *a, const gene_t *b, gene_t *child, std::mt19937 &gen) {
+        std::uniform_int_distribution<int> cut(0, n - 1);
+        int first = cut(gen), last = cut(gen);
+        if (first > last) std::swap(first, last);
+        switch (crossover) {
+            case Crossover::ORDER:
+                order_crossover(a, b, child, first, last);
+                break;
+            case Crossover::PARTIALLY_MAPPED:
+                partially_mapped_crossover(a, b, child, first, last);
+                break;
+            case Crossover::CYCLE:
+                cycle_crossover(a, b, child);
+                break;
+        }
+    }
+
+    void order_crossover(const gene_t *a, const gene_t *b, gene_t *child, int first, int last) {
+        taken.assign(n, 0);
+        for (int i = first; i <= last; i++) {
+            child[i] = a[i];
+            taken[a[i]] = 1;
+        }
+        // The rest in the order of b, starting after the segment
+        int target = (last + 1) % n;
+        for (int k = 0; k < n; k++) {
+            gene_t value = b[(last + 1 + k) % n];
+            if (!taken[value]) {
+                child[target] = value;
+                target = (target + 1) % n;
+            }
+        }
+    }
+
+    void partially_mapped_crossover(const gene_t *a, const gene_t *b, gene_t *child, int first, int last) {
+        taken.assign(n, 0);
+        position.resize(n);
+        for (int i = 0; i < n; i++) {
+            position[a[i]] = i;
+        }
+        for (int i = first; i <= last; i++) {
+            child[i] = a[i];
+            taken[a[i]] = 1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (i >= first && i <= last) continue;
+            // Follow the mapping of the segment until the value is not in it
+            gene_t value = b[i];
+            while (taken[value]) {
+                value = b[position[value]];
+            }
+            child[i] = value;
+        }
+    }
+
+    void cycle_crossover(const gene_t *a, const gene_t *b, gene_t *child) {
+        taken.assign(n, 0);  // Positions already filled
+        position.resize(n);
+        for (int i = 0; i < n; i++) {
+            position[a[i]] = i;
+        }
+        bool from_a = true;
+        for (int start = 0; start < n; start++) {
+            if (taken[start]) continue;
+            int i = start;
+            do {
+                child[i] = from_a ? a[i] : b[i];
+                taken[i] = 1;
+                i = position[b[i]];
+            } while (i != start);
+            from_a = !from_a;
+        }
+    }
+};
@@ -0,0 +1,264 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "communicator.hpp"
+#include "rng.hpp"
+
+#define MIGRATION_TAG 17
+
+/**
+ * Migration topologies
+ * @param RING: every island sends to the next rank
+ * @param RANDOM: every island sends to a random other rank on each migration
+ * @param TORUS: ranks are arranged in a 2d periodic grid, every island sends to its 4 neighbours
+ */
+enum class MigrationTopology {
+    RING = 0,
+    RANDOM = 1,
+    TORUS = 2,
+};
+
+/**
+ * Replacement policies, decide what happens with incoming migrants
+ * @param REPLACE_WORST: migrants always replace the worst solutions of the island and the chain restarts from the best migrant
+ * @param REPLACE_IF_BETTER: migrants only replace worse solutions of the island and the chain moves to the best migrant only if it is better than the current one
+ */
+enum class ReplacementPolicy {
+    REPLACE_WORST = 0,
+    REPLACE_IF_BETTER = 1,
+};
+
+/**
+ * Island model for parallel solvers.
+ * Every rank of the communicator is an island keeping the k best distinct solutions it found (its elite).
+ * On migration only the elite is sent, together with the costs, to the neighbouring islands,
+ * so the receiver never has to evaluate the migrants again.
+ * Receives are nonblocking and are polled between the iterations of the solver.
+ * One buffer is sent to all the neighbours, with threads as ranks they all read the same buffer.
+ *
+ * @tparam T the type of the solution, must provide packed_bytes(n), pack and unpack (e.g. Permutation)
+ */
+template <typename T>
+class IslandModel {
+   public:
+    /**
+     * Constructor
+     * @param solution_size number of elements in a single solution
+     * @param num_migrants number of best solutions sent on each migration (k)
+     * @param topology the migration topology
+     * @param policy the replacement policy
+     * @param comm the islands, must outlive the island model
+     */
+    IslandModel(int solution_size, int num_migrants, MigrationTopology topology, ReplacementPolicy policy, Communicator &comm)
+        : solution_size(solution_size), num_migrants(num_migrants), topology(topology), policy(policy), comm(comm) {
+        rank = comm.rank();
+        num_procs = comm.size();
+        migrant_bytes = sizeof(double) + T::packed_bytes(solution_size);
+        sent_to = std::vector<int>(num_procs, 0);
+        init_neighbours();
+    }
+
+    /**
+     * Offer a solution to the elite of the island.
+     * It is kept if it is one of the k best distinct solutions seen so far.
+     * @param solution the solution
+     * @param cost the cost of the solution
+     */
+    void offer(const T &solution, double cost) {
+        if (elite.size() == num_migrants && cost >= elite.back().second) {
+            return;
+        }
+        insert_elite(solution, cost);
+    }
+
+    /**
+     * Send the elite of the island to its neighbours, does not block
+     */
+    void emigrate() {
+        if (elite.empty() || num_procs == 1) {
+            return;
+        }
+        auto buffer = std::make_shared<std::vector<char>>(elite.size() * migrant_bytes);
+        char *ptr = buffer->data();
+        for (auto &[solution, cost] : elite) {
+            std::memcpy(ptr, &cost, sizeof(double));
+            solution.pack(ptr + sizeof(double));
+            ptr += migrant_bytes;
+        }
+
+        std::vector<int> destinations = neighbours;
+        if (topology == MigrationTopology::RANDOM) {
+            int dest = random_rank->getNext();
+            destinations = {dest >= rank ? dest + 1 : dest};  // any rank but this one
+        }
+        for (int dest : destinations) {
+            comm.send(dest, MIGRATION_TAG, buffer);
+            sent_to[dest]++;
+        }
+    }
+
+    /**
+     * Poll for migrants and apply the replacement policy.
+     * @param current the current solution of the chain, may be replaced by a migrant
+     * @param current_cost the cost of the current solution, updated with the solution
+     * @return true if the current solution was replaced
+     */
+    bool immigrate(T &current, double &current_cost) {
+        if (num_procs == 1) {
+            return false;
+        }
+        bool replaced = false;
+        while (Message message = comm.receive(MIGRATION_TAG, false)) {
+            replaced |= accept(*message, current, current_cost);
+        }
+        return replaced;
+    }
+
+    /**
+     * Finish the migration, must be called by all processes.
+     * Receives the migrants still in flight so that no send is left unmatched
+     * and no message is left in flight when the communicator is finalized.
+     */
+    void finish() {
+        comm.allreduce(sent_to.data(), num_procs, ReduceOp::SUM);
+        int expected = sent_to[rank];
+        while (received < expected) {
+            comm.receive(MIGRATION_TAG, true);
+            received++;
+        }
+        comm.complete_sends();
+        std::fill(sent_to.begin(), sent_to.end(), 0);
+        received = 0;
+        comm.barrier();
+    }
+
+    /**
+     * Get the elite of the island, sorted from the best
+     */
+    const std::vector<std::pair<T, double>> &get_elite() const { return elite; }
+
+   private:
+    int rank;
+    int num_procs;
+    int solution_size;
+    size_t num_migrants;
+    size_t migrant_bytes;
+    MigrationTopology topology;
+    ReplacementPolicy policy;
+    Communicator &comm;
+
+    std::vector<int> neighbours;          // Destinations of the static topologies
+    std::unique_ptr<IntRNG> random_rank;  // Destination generator of the random topology
+
+    std::vector<std::pair<T, double>> elite;  // k best distinct solutions, sorted by cost
+
+    int received = 0;          // Number of received messages
+    std::vector<int> sent_to;  // Number of messages sent to each rank
+
+    void init_neighbours() {
+        if (num_procs == 1) {
+            return;
+        }
+        switch (topology) {
+            case MigrationTopology::RING:
+                neighbours = {(rank + 1) % num_procs};
+                break;
+            case MigrationTopology::RANDOM:
+                random_rank = std::make_unique<IntRNG>(0, num_procs - 2);
+                break;
+            case MigrationTopology::TORUS: {
+                // The most square grid, dims[0] >= dims[1] as MPI_Dims_create would give
+                int dims[2] = {num_procs, 1};
+                for (int d = (int)std::sqrt(num_procs); d > 1; d--) {
+                    if (num_procs % d == 0) {
+                        dims[0] = num_procs / d;
+                        dims[1] = d;
+                        break;
+                    }
+                }
+                int row = rank / dims[1], col = rank % dims[1];
+                int candidates[4] = {
+                    ((row + dims[0] - 1) % dims[0]) * dims[1] + col,
+                    ((row + 1) % dims[0]) * dims[1] + col,
+                    row * dims[1] + (col + dims[1] - 1) % dims[1],
+                    row * dims[1] + (col + 1) % dims[1],
+                };
+                for (int c : candidates) {
+                    if (c != rank && std::find(neighbours.begin(), neighbours.end(), c) == neighbours.end()) {
+                        neighbours.push_back(c);
+                    }
+                }
+                break;
+            }
+            default:
+                throw std::runtime_error("Invalid migration topology");
+        }
+    }
+
+    /**
+     * Check if a solution is already in the elite
+     */
+    bool in_elite(const T &solution, double cost) const {
+        for (auto &member : elite) {
+            if (member.second == cost && member.first == solution) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Insert a solution into the elite, keeping it sorted and without duplicates
+     * @return true if the solution was inserted
+     */
+    bool insert_elite(const T &solution, double cost) {
+        if (in_elite(solution, cost)) {
+            return false;
+        }
+        auto pos = std::find_if(elite.begin(), elite.end(), [&](const std::pair<T, double> &member) { return member.second > cost; });
+        elite.insert(pos, {solution, cost});
+        if (elite.size() > num_migrants) {
+            elite.pop_back();
+        }
+        return true;
+    }
+
+    bool accept(const std::vector<char> &message, T &current, double &current_cost) {
+        received++;
+        int count = message.size() / migrant_bytes;
+
+        T best_migrant;
+        double best_migrant_cost = 0;
+        const char *ptr = message.data();
+        for (int i = 0; i < count; i++, ptr += migrant_bytes) {
+            double cost;
+            T migrant(solution_size);
+            std::memcpy(&cost, ptr, sizeof(double));
+            migrant.unpack(ptr + sizeof(double));
+
+            if (policy == ReplacementPolicy::REPLACE_WORST && elite.size() == num_migrants && !in_elite(migrant, cost)) {
+                elite.pop_back();  // make room for the migrant whatever its cost, a duplicate is not inserted
+            }
+            offer(migrant, cost);
+            if (i == 0 || cost < best_migrant_cost) {
+                best_migrant = migrant;
+                best_migrant_cost = cost;
+            }
+        }
+        if (count == 0) {
+            return false;
+        }
+        if (policy == ReplacementPolicy::REPLACE_WORST || best_migrant_cost < current_cost) {
+            current = best_migrant;
+            current_cost = best_migrant_cost;
+            return true;
+        }
+        return false;
+    }
+};
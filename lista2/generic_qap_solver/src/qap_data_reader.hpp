@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <tuple>
 #include <vector>
 typedef std::vector<std::vector<int>> IntMatrix;
 
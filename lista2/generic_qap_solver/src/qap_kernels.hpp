@@ -0,0 +1,89 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "permutation.hpp"
+#include "qap_data_reader.hpp"
+#include "shared_matrix.hpp"
+
+// Full cost function of a QAP assignment
+typedef std::function<int(const Permutation &)> QapCostKernel;
+
+/**
+ * QAP cost kernel for a size known at compile time.
+ * The matrices are kept in fixed size arrays and the inner loop is fully unrolled.
+ * @tparam N the size of the instance
+ */
+template <int N>
+class FixedQapKernel {
+   public:
+    FixedQapKernel(IntMatrixView distanceMatrix, IntMatrixView flowMatrix) {
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                distance[i][j] = distanceMatrix[i][j];
+                flow[i][j] = flowMatrix[i][j];
+            }
+        }
+    }
+
+    int cost(const Permutation &candidate) const {
+        int location[N];
+        for (int i = 0; i < N; i++) {
+            location[i] = candidate[i];
+        }
+        int cost = 0;
+        for (int i = 0; i < N; i++) {
+            const int *distance_row = distance[location[i]];
+#pragma GCC unroll 32
+            for (int j = 0; j < N; j++) {
+                cost += flow[i][j] * distance_row[location[j]];
+            }
+        }
+        return cost;
+    }
+
+    /**
+     * Wrap the kernel in a cost function
+     */
+    static QapCostKernel make(IntMatrixView distanceMatrix, IntMatrixView flowMatrix) {
+        auto kernel = std::make_shared<FixedQapKernel<N>>(distanceMatrix, flowMatrix);
+        return [kernel](const Permutation &candidate) { return kernel->cost(candidate); };
+    }
+
+   private:
+    int distance[N][N];
+    int flow[N][N];
+};
+
+/**
+ * Pick the cost kernel specialized for the size of the instance,
+ * instances of other sizes use the generic loop.
+ * The specialized kernels keep their own copy of the matrices, the generic one reads the views.
+ * @param distanceMatrix distance matrix
+ * @param flowMatrix flow matrix
+ */
+inline QapCostKernel make_qap_cost_kernel(IntMatrixView distanceMatrix, IntMatrixView flowMatrix) {
+    switch (flowMatrix.size()) {
+        case 12:
+            return FixedQapKernel<12>::make(distanceMatrix, flowMatrix);
+        case 16:  // esc16i
+            return FixedQapKernel<16>::make(distanceMatrix, flowMatrix);
+        case 20:  // chr20a
+            return FixedQapKernel<20>::make(distanceMatrix, flowMatrix);
+        case 26:  // bur26b
+            return FixedQapKernel<26>::make(distanceMatrix, flowMatrix);
+        case 32:
+            return FixedQapKernel<32>::make(distanceMatrix, flowMatrix);
+        default:
+            return [distanceMatrix, flowMatrix](const Permutation &candidate) {
+                int cost = 0;
+                for (int i = 0; i < candidate.size(); i++) {
+                    for (int j = 0; j < candidate.size(); j++) {
+                        cost += flowMatrix[i][j] * distanceMatrix[candidate[i]][candidate[j]];
+                    }
+                }
+                return cost;
+            };
+    }
+}
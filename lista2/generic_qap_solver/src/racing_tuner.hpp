@@ -0,0 +1,307 @@
+#pragma once
+#include <mpi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Range of a tuned parameter
+ */
+struct TunedParameter {
+    std::string name;        // Name of the parameter, the option of the solver
+    double min;              // Smallest value
+    double max;              // Largest value
+    bool integer = false;    // Round the sampled values
+    bool log_scale = false;  // Sample uniformly in log space, for scale parameters such as temperatures
+};
+
+typedef std::map<std::string, double> ParameterConfiguration;
+
+/**
+ * Replace the range of a parameter
+ * @param parameter the parameter
+ * @param range the new range as "min:max", empty keeps the range
+ */
+inline TunedParameter with_range(TunedParameter parameter, const std::string &range) {
+    if (range.empty()) {
+        return parameter;
+    }
+    size_t colon = range.find(':');
+    if (colon == std::string::npos) {
+        throw std::runtime_error("Invalid range " + range + " of " + parameter.name + ", expected min:max");
+    }
+    parameter.min = std::stod(range.substr(0, colon));
+    parameter.max = std::stod(range.substr(colon + 1));
+    return parameter;
+}
+
+/**
+ * Racing tuner in the style of F-Race.
+ * A set of candidate configurations is evaluated block by block, a block is one instance with one seed
+ * shared by all configurations (common random numbers). Once enough blocks are done, after every block the
+ * Friedman test on the ranks of the costs within the blocks checks if the surviving configurations differ,
+ * if they do every configuration whose rank sum is significantly worse than the best one is eliminated
+ * (Conover's post-hoc test). The race ends when one configuration is left or the budget is spent.
+ *
+ * The configurations of a block are dealt round robin to the processes, every evaluation runs
+ * on a single process, so the evaluation must not communicate over the communicator of the tuner.
+ */
+class RacingTuner {
+   public:
+    /**
+     * Evaluation of a configuration, returns the cost reached (lower is better)
+     * @param configuration the parameters
+     * @param instance index of the instance
+     * @param seed the seed of the block
+     */
+    typedef std::function<double(const ParameterConfiguration &, int, unsigned)> Evaluation;
+
+    /**
+     * @param parameters the tuned parameters and their ranges
+     * @param comm communicator of the processes evaluating the configurations
+     */
+    RacingTuner(std::vector<TunedParameter> parameters, MPI_Comm comm = MPI_COMM_WORLD) : parameters(parameters), comm(comm) {
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &num_procs);
+    }
+
+    /**
+     * Set the confidence level of the tests, 0.95 by default
+     */
+    void set_confidence(double confidence) { this->confidence = confidence; }
+
+    /**
+     * Set the number of blocks done before the first test, 5 by default
+     */
+    void set_first_test(int blocks) { first_test = std::max(2, blocks); }
+
+    /**
+     * Add a candidate configuration, e.g. the hand picked defaults, the rest of the candidates is sampled
+     */
+    void add_configuration(const ParameterConfiguration &configuration) { initial.push_back(configuration); }
+
+    /**
+     * Race the candidates, collective over the communicator
+     * @param num_candidates number of candidate configurations, including the added ones
+     * @param budget maximal number of evaluations
+     * @param num_instances number of instances of the class, the blocks cycle through them
+     * @param evaluate the evaluation of a configuration
+     * @param seed seed of the sampling and of the blocks, must be the same on all processes
+     * @return the best configuration
+     */
+    ParameterConfiguration race(int num_candidates, int budget, int num_instances, Evaluation evaluate, unsigned seed) {
+        std::mt19937 gen(seed);
+        entries.clear();
+        for (const ParameterConfiguration &configuration : initial) {
+            entries.push_back(Entry{configuration, {}, 0.0});
+        }
+        while ((int)entries.size() < num_candidates) {
+            entries.push_back(Entry{sample(gen), {}, 0.0});
+        }
+
+        int evaluations = 0;
+        num_blocks = 0;
+        std::vector<int> alive(entries.size());
+        std::iota(alive.begin(), alive.end(), 0);
+        while (alive.size() > 1 && evaluations + (int)alive.size() <= budget) {
+            int instance = num_blocks % num_instances;
+            unsigned block_seed = seed + num_blocks;
+            // Every result is computed by one process and summed into the others
+            std::vector<double> costs(alive.size(), 0.0);
+            for (size_t i = rank; i < alive.size(); i += num_procs) {
+                costs[i] = evaluate(entries[alive[i]].configuration, instance, block_seed);
+            }
+            MPI_Allreduce(MPI_IN_PLACE, costs.data(), costs.size(), MPI_DOUBLE, MPI_SUM, comm);
+            for (size_t i = 0; i < alive.size(); i++) {
+                entries[alive[i]].costs.push_back(costs[i]);
+            }
+            evaluations += alive.size();
+            num_blocks++;
+
+            if (num_blocks >= first_test) {
+                alive = eliminate(alive);
+            }
+        }
+
+        // The survivor with the lowest rank sum wins
+        std::vector<double> rank_sums = rank_sums_of(alive);
+        int best = std::min_element(rank_sums.begin(), rank_sums.end()) - rank_sums.begin();
+        for (size_t i = 0; i < alive.size(); i++) {
+            entries[alive[i]].mean_rank = num_blocks > 0 ? rank_sums[i] / num_blocks : 0.0;
+        }
+        best_entry = alive[best];
+        return entries[best_entry].configuration;
+    }
+
+    /**
+     * Print all candidates, the survivors first, on rank 0 of the communicator
+     */
+    void print(std::ostream &out) const {
+        if (rank != 0) {
+            return;
+        }
+        std::vector<int> order(entries.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            if (entries[a].costs.size() != entries[b].costs.size()) return entries[a].costs.size() > entries[b].costs.size();
+            return mean(entries[a].costs) < mean(entries[b].costs);
+        });
+        out << "Blocks: " << num_blocks << std::endl;
+        for (int i : order) {
+            const Entry &entry = entries[i];
+            out << (i == best_entry ? "* " : "  ");
+            for (auto &[name, value] : entry.configuration) {
+                out << name << "=" << value << " ";
+            }
+            out << "| blocks " << entry.costs.size() << " | mean cost " << mean(entry.costs);
+            if (entry.costs.size() == (size_t)num_blocks) {
+                out << " | mean rank " << entry.mean_rank;
+            }
+            out << std::endl;
+        }
+    }
+
+   private:
+    struct Entry {
+        ParameterConfiguration configuration;
+        std::vector<double> costs;  // Cost in every block the configuration took part in
+        double mean_rank = 0;       // Mean rank among the survivors
+    };
+
+    std::vector<TunedParameter> parameters;
+    MPI_Comm comm;
+    int rank;
+    int num_procs;
+    double confidence = 0.95;
+    int first_test = 5;
+    std::vector<ParameterConfiguration> initial;
+    std::vector<Entry> entries;
+    int num_blocks = 0;
+    int best_entry = -1;
+
+    ParameterConfiguration sample(std::mt19937 &gen) const {
+        ParameterConfiguration configuration;
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        for (const TunedParameter &parameter : parameters) {
+            double u = uniform(gen);
+            double value = parameter.log_scale ? parameter.min * std::pow(parameter.max / parameter.min, u) : parameter.min + u * (parameter.max - parameter.min);
+            configuration[parameter.name] = parameter.integer ? std::round(value) : value;
+        }
+        return configuration;
+    }
+
+    /**
+     * Sums of the ranks of the configurations over all blocks, ties get the mean rank
+     */
+    std::vector<double> rank_sums_of(const std::vector<int> &alive) const {
+        std::vector<double> sums(alive.size(), 0.0);
+        for (int b = 0; b < num_blocks; b++) {
+            std::vector<double> ranks = block_ranks(alive, b);
+            for (size_t i = 0; i < alive.size(); i++) {
+                sums[i] += ranks[i];
+            }
+        }
+        return sums;
+    }
+
+    std::vector<double> block_ranks(const std::vector<int> &alive, int block) const {
+        int k = alive.size();
+        std::vector<int> order(k);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return entries[alive[a]].costs[block] < entries[alive[b]].costs[block]; });
+        std::vector<double> ranks(k);
+        for (int i = 0; i < k;) {
+            int j = i;
+            while (j + 1 < k && entries[alive[order[j + 1]]].costs[block] == entries[alive[order[i]]].costs[block]) j++;
+            for (int t = i; t <= j; t++) {
+                ranks[order[t]] = (i + j) / 2.0 + 1;
+            }
+            i = j + 1;
+        }
+        return ranks;
+    }
+
+    /**
+     * Friedman test over the survivors and Conover's post-hoc comparison with the best one
+     * @return the survivors of the test
+     */
+    std::vector<int> eliminate(const std::vector<int> &alive) const {
+        double b = num_blocks, k = alive.size();
+        std::vector<double> sums = rank_sums_of(alive);
+        double a1 = 0.0;  // Sum of the squared ranks
+        for (int block = 0; block < num_blocks; block++) {
+            for (double r : block_ranks(alive, block)) {
+                a1 += r * r;
+            }
+        }
+        double c1 = b * k * (k + 1) * (k + 1) / 4;
+        double sum_squares = 0.0;
+        for (double sum : sums) {
+            sum_squares += sum * sum;
+        }
+        if (a1 - c1 <= 0) {
+            return alive;  // All blocks are ties
+        }
+        double statistic = (k - 1) * (sum_squares - b * c1) / (a1 - c1);
+        if (statistic <= chi_square_quantile(confidence, k - 1)) {
+            return alive;
+        }
+
+        double best = *std::min_element(sums.begin(), sums.end());
+        double df = (b - 1) * (k - 1);
+        double critical = t_quantile(1 - (1 - confidence) / 2, df) * std::sqrt(2 * b * (1 - statistic / (b * (k - 1))) * (a1 - c1) / df);
+        std::vector<int> survivors;
+        for (size_t i = 0; i < alive.size(); i++) {
+            if (sums[i] - best <= critical) {
+                survivors.push_back(alive[i]);
+            }
+        }
+        return survivors;
+    }
+
+    static double mean(const std::vector<double> &values) {
+        return values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    }
+
+    /**
+     * Quantile of the standard normal distribution, by bisection of the cdf
+     */
+    static double normal_quantile(double p) {
+        double low = -10, high = 10;
+        for (int i = 0; i < 100; i++) {
+            double mid = (low + high) / 2;
+            if (0.5 * std::erfc(-mid / std::sqrt(2.0)) < p) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        return (low + high) / 2;
+    }
+
+    /**
+     * Quantile of the chi-square distribution, Wilson-Hilferty approximation
+     */
+    static double chi_square_quantile(double p, double df) {
+        double z = normal_quantile(p);
+        double h = 2 / (9 * df);
+        return df * std::pow(1 - h + z * std::sqrt(h), 3);
+    }
+
+    /**
+     * Quantile of the Student's t distribution, Cornish-Fisher expansion
+     */
+    static double t_quantile(double p, double df) {
+        double z = normal_quantile(p);
+        double z3 = z * z * z, z5 = z3 * z * z;
+        return z + (z3 + z) / (4 * df) + (5 * z5 + 16 * z3 + 3 * z) / (96 * df * df);
+    }
+};
@@ -1,24 +1,68 @@
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <iostream>
 #include <list>
 #include <memory>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "cost_cache.hpp"
+#include "island_model.hpp"
 #include "rng.hpp"
 #define NO_EXCHANGE_PERIOD -1
 #define NO_TIME_LIMIT -1
+#define AUTO_INITIAL_TEMP -1
+#define CALIBRATION_SAMPLES 100
 
 /**
  * Interface for cooling strategies
  */
 class CoolingStrategy {
    public:
+    virtual ~CoolingStrategy() = default;
     /**
      * Get the next temperature.
      * This function is called after each iteration
      * @param prev_t the previous temperature
      */
     virtual double next(double prev_t) = 0;
+    /**
+     * Called once before the first iteration
+     * @param num_iter the number of iterations of the run
+     * @param initial_t the initial temperature
+     */
+    virtual void start(int /*num_iter*/, double /*initial_t*/) {}
+    /**
+     * Feedback about the move made in the last iteration, called before next
+     * @param delta the cost change of the move
+     * @param accepted whether the move was accepted
+     * @param improved whether the move improved the best solution found so far
+     */
+    virtual void feedback(double /*delta*/, bool /*accepted*/, bool /*improved*/) {}
+    /**
+     * Calculate the initial temperature from the cost changes of a sample of random moves,
+     * so that an average uphill move is accepted with the given probability
+     * t_0 = -mean(uphill deltas) / ln(acceptance)
+     * @param deltas cost changes of the sampled moves
+     * @param acceptance the initial acceptance probability of an uphill move
+     */
+    static double calibrate(const std::vector<double> &deltas, double acceptance = 0.8) {
+        double sum = 0;
+        int uphill = 0;
+        for (double delta : deltas) {
+            if (delta > 0) {
+                sum += delta;
+                uphill++;
+            }
+        }
+        if (uphill == 0) {
+            return 1.0;
+        }
+        return -(sum / uphill) / std::log(acceptance);
+    }
 };
 
 /**
@@ -64,6 +108,135 @@ class LogarithmicCoolingStrategy : public CoolingStrategy {
     double lambda;
 };
 
+/**
+ * Adaptive cooling strategy (Lam-style)
+ * The temperature is adjusted so that the acceptance rate follows the target schedule
+ * rho(f) = 0.44 + 0.56 * 560^(-f / 0.15)     for f < 0.15
+ * rho(f) = 0.44                            for 0.15 <= f < 0.65
+ * rho(f) = 0.44 * 440^(-(f - 0.65) / 0.35)  for f >= 0.65
+ * where f is the fraction of the iterations done.
+ * The acceptance rate is an exponential moving average of the accepted moves.
+ */
+class LamCoolingStrategy : public CoolingStrategy {
+   public:
+    /**
+     * @param adjustment relative change of the temperature per iteration
+     * @param smoothing weight of the last move in the acceptance rate average
+     */
+    LamCoolingStrategy(double adjustment = 0.01, double smoothing = 0.02) : adjustment(adjustment), smoothing(smoothing) {}
+
+    void start(int num_iter, double /*initial_t*/) override {
+        this->num_iter = num_iter;
+        iter = 0;
+        acceptance_rate = 0.5;
+    }
+
+    void feedback(double /*delta*/, bool accepted, bool /*improved*/) override {
+        acceptance_rate = (1 - smoothing) * acceptance_rate + smoothing * (accepted ? 1.0 : 0.0);
+    }
+
+    double next(double prev_t) override {
+        double target = target_rate((double)iter++ / num_iter);
+        return acceptance_rate > target ? prev_t * (1 - adjustment) : prev_t / (1 - adjustment);
+    }
+
+    static double target_rate(double f) {
+        if (f < 0.15) return 0.44 + 0.56 * std::pow(560, -f / 0.15);
+        if (f < 0.65) return 0.44;
+        return 0.44 * std::pow(440, -(f - 0.65) / 0.35);
+    }
+
+   private:
+    double adjustment;
+    double smoothing;
+    int num_iter = 1;
+    int iter = 0;
+    double acceptance_rate = 0.5;
+};
+
+/**
+ * Reheating decorator for any cooling strategy
+ * If the best solution did not improve for a given number of iterations
+ * the temperature is multiplied by reheat_factor (capped at the initial temperature)
+ */
+class ReheatingCoolingStrategy : public CoolingStrategy {
+   public:
+    /**
+     * @param inner the decorated cooling strategy
+     * @param stagnation number of iterations without improvement that trigger the reheat
+     * @param reheat_factor the factor the temperature is multiplied by on reheat
+     */
+    ReheatingCoolingStrategy(std::unique_ptr<CoolingStrategy> inner, int stagnation, double reheat_factor)
+        : inner(std::move(inner)), stagnation(stagnation), reheat_factor(reheat_factor) {}
+
+    void start(int num_iter, double initial_t) override {
+        this->initial_t = initial_t;
+        since_improvement = 0;
+        inner->start(num_iter, initial_t);
+    }
+
+    void feedback(double delta, bool accepted, bool improved) override {
+        since_improvement = improved ? 0 : since_improvement + 1;
+        inner->feedback(delta, accepted, improved);
+    }
+
+    double next(double prev_t) override {
+        double t = inner->next(prev_t);  // the inner strategy advances on every iteration, a reheat only overrides its temperature
+        if (since_improvement >= stagnation) {
+            since_improvement = 0;
+            return std::min(initial_t, prev_t * reheat_factor);
+        }
+        return t;
+    }
+
+   private:
+    std::unique_ptr<CoolingStrategy> inner;
+    int stagnation;
+    double reheat_factor;
+    double initial_t = 0;
+    int since_improvement = 0;
+};
+
+/**
+ * Create a cooling strategy by name
+ * @param name linear, geometric, logarithmic, lam or reheat (lam with reheating)
+ * @param parameter the cooling rate of linear and geometric, lambda of logarithmic,
+ * the number of iterations without improvement before a reheat of reheat, unused by lam
+ */
+inline std::unique_ptr<CoolingStrategy> make_cooling_strategy(const std::string &name, double parameter) {
+    if (name == "linear") {
+        return std::make_unique<LinearCoolingStrategy>(parameter);
+    } else if (name == "geometric") {
+        return std::make_unique<GeometricCoolingStrategy>(parameter);
+    } else if (name == "logarithmic") {
+        return std::make_unique<LogarithmicCoolingStrategy>(parameter);
+    } else if (name == "lam") {
+        return std::make_unique<LamCoolingStrategy>();
+    } else if (name == "reheat") {
+        return std::make_unique<ReheatingCoolingStrategy>(std::make_unique<LamCoolingStrategy>(), (int)parameter, 2.0);
+    }
+    throw std::runtime_error("Unknown cooling strategy " + name);
+}
+
+/**
+ * Default parameter of a cooling strategy, the parameters of the strategies have different meanings and scales
+ * @param name the name of the strategy, as for make_cooling_strategy
+ * @return 0.996 for geometric, 200 iterations for reheat, 0 for lam (unused)
+ * @throws std::runtime_error for linear and logarithmic, their step and lambda depend on the costs of the instance
+ */
+inline double default_cooling_param(const std::string &name) {
+    if (name == "geometric") {
+        return 0.996;
+    } else if (name == "reheat") {
+        return 200;
+    } else if (name == "lam") {
+        return 0;
+    } else if (name == "linear" || name == "logarithmic") {
+        throw std::runtime_error("The " + name + " cooling needs --cooling-param");
+    }
+    throw std::runtime_error("Unknown cooling strategy " + name);
+}
+
 /**
  * Simmulated Annealing Solver, a generic solver for the simmulated annealing algorithm
  * with
@@ -80,67 +253,221 @@ class SimmulatedAnnealingSolver {
      * @param exchange_solutions the exchange solutions function
      * @param cooling_strategy the cooling strategy
      */
-    SimmulatedAnnealingSolver(std::function<double(T &)> cost, std::function<void(T &)> make_change, std::function<T()> init_start_sol, std::function<std::list<T>(T &)> exchange_solutions, std::unique_ptr<CoolingStrategy> cooling_strategy, std::function<void(T &, double)> on_new_best_solution) : cost(cost), make_change(make_change), init_start_sol(init_start_sol), exchange_solutions(exchange_solutions), cooling_strategy(std::move(cooling_strategy)), on_new_solution(on_new_best_solution) {}
+    SimmulatedAnnealingSolver(std::function<double(T &)> cost, std::function<void(T &)> make_change, std::function<T()> init_start_sol, std::function<std::list<std::pair<T, double>>(T &, double)> exchange_solutions, std::unique_ptr<CoolingStrategy> cooling_strategy, std::function<void(T &, double)> on_new_best_solution) : cost(cost), make_change(make_change), init_start_sol(init_start_sol), exchange_solutions(exchange_solutions), cooling_strategy(std::move(cooling_strategy)), on_new_solution(on_new_best_solution) {}
+    /**
+     * Use the island model for the communication between processes instead of exchange_solutions.
+     * Migrants are sent with their costs and received without blocking, so they are never evaluated again.
+     * @param island_model the island model, must outlive the calls to solve
+     */
+    void set_island_model(IslandModel<T> *island_model) { this->island_model = island_model; }
+
+    /**
+     * Evaluate a batch of moves from the current solution in parallel on the given number of threads.
+     * The first move accepted in the order of the batch is made and the rest is discarded,
+     * which gives the same Markov chain as evaluating the moves one by one,
+     * so at low temperatures, where most moves are rejected, up to num_threads iterations are done at the cost of one.
+     * The cost function has to be safe to call from multiple threads.
+     * @param num_threads number of moves evaluated at once, 1 disables the speculation
+     */
+    void set_speculative_threads(int num_threads) { speculative_threads = std::max(1, num_threads); }
+
+    /**
+     * Set the function undoing the last make_change, the solution is then changed in place
+     * instead of being copied in every iteration (only without speculation)
+     * @param undo_change the undo function
+     */
+    void set_undo_change(std::function<void(T &)> undo_change) { this->undo_change = undo_change; }
+
+    /**
+     * Look up the costs of the candidates in a cache before evaluating them, at low temperatures the chain
+     * proposes the same moves from the same solution again and again
+     * @param cache the cache, may be shared with other solvers and must outlive the calls to solve
+     * @param hash the hash of a solution, cheap compared to the cost (e.g. the incremental Permutation::hash)
+     */
+    void set_cost_cache(CostCache *cache, std::function<uint64_t(const T &)> hash) {
+        cost_cache = cache;
+        this->hash = hash;
+    }
+
+    /**
+     * Number of costs looked up in the cache and found there by the last call to solve
+     */
+    std::pair<long, long> cache_statistics() const { return {cache_lookups, cache_hits}; }
+
+    /**
+     * Seed the acceptance test, a random seed is used by default
+     * @param seed the seed, should differ between processes
+     */
+    void set_seed(unsigned seed) {
+        this->seed = seed;
+        seeded = true;
+    }
+
     /**
      * Solve the problem
      * @param num_iter the number of iterations
-     * @param inital_temp the initial temperature
+     * @param inital_temp the initial temperature, AUTO_INITIAL_TEMP calibrates it from a sample of random moves
      * @param exchange_period the exchange period
      * @param time_limit the time limit
      * @return a pair of the best solution and the cost of the best solution
      */
     std::pair<T, double> solve(int num_iter, double inital_temp, int exchange_period = NO_EXCHANGE_PERIOD, double time_limit = NO_TIME_LIMIT) {
-        DoubleRNG prob = DoubleRNG(0, 1);
+        DoubleRNG prob = seeded ? DoubleRNG(0, 1, seed) : DoubleRNG(0, 1);
         if (exchange_period == NO_EXCHANGE_PERIOD) {
             exchange_period = num_iter;
         }
 
+        cache_lookups = 0;
+        cache_hits = 0;
         T best_solution = init_start_sol();
-        T global_best_solution = init_start_sol();
-        double best_cost = cost(best_solution);
-        double t = inital_temp;
+        T global_best_solution = best_solution;
+        double best_cost = evaluate(best_solution, cache_hits);
+        double global_best_cost = best_cost;
+        double t = inital_temp == AUTO_INITIAL_TEMP ? calibrate_temperature(best_solution, best_cost) : inital_temp;
+        cooling_strategy->start(num_iter, t);
 
-        int rank;
-        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-        double start = MPI_Wtime();
-        for (int i = 0; i < num_iter; i++) {
-            if (time_limit != NO_TIME_LIMIT && MPI_Wtime() - start > time_limit) {
-                MPI_Barrier(MPI_COMM_WORLD);
+        double start = Communicator::wtime();
+        for (int i = 0; i < num_iter;) {
+            if (time_limit != NO_TIME_LIMIT && Communicator::wtime() - start > time_limit) {
                 break;
             }
-            T prev_solution = best_solution;
-            make_change(best_solution);
-            double current_cost = cost(best_solution);
-            auto delta = current_cost - best_cost;
-            if (current_cost < best_cost) {
-                best_cost = current_cost;
-                global_best_solution = best_solution;
-            } else if (prob.getNext() < exp(-delta / t)) {
-                best_cost = current_cost;
+            // Speculatively make a batch of moves from the current solution, make_change is called sequentially
+            // as it usually shares a random generator, only the costs are evaluated in parallel
+            int batch_size = std::min(speculative_threads, num_iter - i);
+            // Without speculation the move is made in place and undone if rejected, no copy is needed
+            bool in_place = batch_size == 1 && undo_change;
+            std::vector<T> candidates(in_place ? 0 : batch_size, best_solution);
+            std::vector<double> candidate_costs(batch_size);
+            if (in_place) {
+                make_change(best_solution);
+                candidate_costs[0] = evaluate(best_solution, cache_hits);
             } else {
-                best_solution = prev_solution;
+                for (int j = 0; j < batch_size; j++) {
+                    make_change(candidates[j]);
+                }
+                long hits = 0;
+#pragma omp parallel for num_threads(batch_size) if (batch_size > 1) reduction(+ : hits)
+                for (int j = 0; j < batch_size; j++) {
+                    candidate_costs[j] = evaluate(candidates[j], hits);
+                }
+                cache_hits += hits;
+            }
+            if (cost_cache) {
+                cache_lookups += batch_size;
             }
-            on_new_solution(best_solution, best_cost);
 
-            if (i % (exchange_period + 1) == 0) {
-                auto gathered_solutions = exchange_solutions(global_best_solution);
+            // Decide in order, rejected moves do not change the state so the first accepted move ends the batch
+            // and the chain is the same as if the moves were made one after another
+            for (int j = 0; j < batch_size; j++, i++) {
+                double current_cost = candidate_costs[j];
+                auto delta = current_cost - best_cost;
+                bool accepted = true;
+                bool improved = false;
+                if (current_cost < best_cost) {
+                    best_cost = current_cost;
+                    if (!in_place) best_solution = std::move(candidates[j]);
+                    if (current_cost < global_best_cost) {
+                        global_best_cost = current_cost;
+                        global_best_solution = best_solution;
+                        improved = true;
+                    }
+                } else if (prob.getNext() < exp(-delta / t)) {
+                    best_cost = current_cost;
+                    if (!in_place) best_solution = std::move(candidates[j]);
+                } else {
+                    if (in_place) undo_change(best_solution);
+                    accepted = false;
+                }
+                cooling_strategy->feedback(delta, accepted, improved);
+                on_new_solution(best_solution, best_cost);
+
+                bool exchanged = false;
+                if (island_model != nullptr) {
+                    if (accepted) {
+                        island_model->offer(best_solution, best_cost);
+                    }
+                    exchanged = island_model->immigrate(best_solution, best_cost);
+                    if (exchanged && cost_cache) {
+                        cost_cache->store(hash(best_solution), best_cost);
+                    }
+                    if (exchanged && best_cost < global_best_cost) {
+                        global_best_cost = best_cost;
+                        global_best_solution = best_solution;
+                    }
+                    if (i % (exchange_period + 1) == 0) {
+                        island_model->emigrate();
+                    }
+                } else if (i % (exchange_period + 1) == 0) {
+                    // The solutions come with their costs, most are copies of the global best and none is evaluated again
+                    auto gathered_solutions = exchange_solutions(global_best_solution, global_best_cost);
 
-                for (auto &solution : gathered_solutions) {
-                    double solution_cost = cost(solution);
-                    if (solution_cost < best_cost) {
-                        best_cost = solution_cost;
-                        best_solution = solution;
+                    for (auto &[solution, solution_cost] : gathered_solutions) {
+                        if (cost_cache) {
+                            cost_cache->store(hash(solution), solution_cost);
+                        }
+                        if (solution_cost < best_cost) {
+                            best_cost = solution_cost;
+                            best_solution = solution;
+                            exchanged = true;
+                        }
+                        if (solution_cost < global_best_cost) {
+                            global_best_cost = solution_cost;
+                            global_best_solution = solution;
+                        }
                     }
                 }
+                t = cooling_strategy->next(t);
+
+                if (accepted || exchanged) {
+                    i++;
+                    break;  // the remaining moves were made from a stale solution
+                }
             }
-            t = cooling_strategy->next(t);
         }
 
-        return {global_best_solution, cost(global_best_solution)};
+        if (island_model != nullptr) {
+            island_model->finish();
+        }
+
+        return {global_best_solution, global_best_cost};
     }
 
    private:
+    /**
+     * Cost of a solution, from the cache if it is set and holds the solution
+     * @param solution the solution
+     * @param hits incremented on a cache hit
+     */
+    double evaluate(T &solution, long &hits) {
+        if (!cost_cache) {
+            return cost(solution);
+        }
+        uint64_t key = hash(solution);
+        double solution_cost;
+        if (cost_cache->find(key, solution_cost)) {
+            hits++;
+            return solution_cost;
+        }
+        solution_cost = cost(solution);
+        cost_cache->store(key, solution_cost);
+        return solution_cost;
+    }
+
+    /**
+     * Calibrate the initial temperature from the cost changes of random moves made from the start solution
+     * @param start the start solution
+     * @param start_cost the cost of the start solution
+     */
+    double calibrate_temperature(const T &start, double start_cost) {
+        std::vector<double> deltas;
+        for (int i = 0; i < CALIBRATION_SAMPLES; i++) {
+            T sample = start;
+            make_change(sample);
+            deltas.push_back(cost(sample) - start_cost);
+        }
+        return CoolingStrategy::calibrate(deltas);
+    }
+
     /**
      * The cooling strategy
      * Some predefined cooling strategies are available
@@ -148,6 +475,8 @@ class SimmulatedAnnealingSolver {
      * @param LinearCoolingStrategy
      * @param GeometricCoolingStrategy
      * @param LogarithmicCoolingStrategy
+     * @param LamCoolingStrategy
+     * @param ReheatingCoolingStrategy
      * @param CoolingStrategy
      */
     std::unique_ptr<CoolingStrategy> cooling_strategy;
@@ -166,6 +495,12 @@ class SimmulatedAnnealingSolver {
      * @param T the solution
      */
     std::function<void(T &)> make_change;
+    /**
+     * The optional undo function, reverts the last make_change
+     *
+     * @param T the solution
+     */
+    std::function<void(T &)> undo_change;
     /**
      * The initial start solution function
      * This function should return the initial solution
@@ -177,7 +512,28 @@ class SimmulatedAnnealingSolver {
      * The implementation of this was designed with openmpi in mind (multi processing, not threading)
      * After the function is called, the best solution is selected and used as the current solution
      * @param T the best solution of the process / worker / thread
+     * @param double the cost of the best solution, returned with the gathered solutions so they are not evaluated again
      */
-    std::function<std::list<T>(T &)> exchange_solutions;
+    std::function<std::list<std::pair<T, double>>(T &, double)> exchange_solutions;
     std::function<void(T &, double)> on_new_solution;
+    /**
+     * The island model, if set it is used instead of exchange_solutions
+     */
+    IslandModel<T> *island_model = nullptr;
+    /**
+     * Number of moves evaluated in parallel in each step
+     */
+    int speculative_threads = 1;
+    /**
+     * The optional cost cache and the hash of the solutions it is indexed by
+     */
+    CostCache *cost_cache = nullptr;
+    std::function<uint64_t(const T &)> hash;
+    long cache_lookups = 0;
+    long cache_hits = 0;
+    /**
+     * Seed of the acceptance test, used if seeded
+     */
+    unsigned seed = 0;
+    bool seeded = false;
 };
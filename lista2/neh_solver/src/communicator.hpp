@@ -0,0 +1,357 @@
+#pragma once
+#include <mpi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Shared read-only message, the thread backend hands the same buffer to all the receivers
+typedef std::shared_ptr<const std::vector<char>> Message;
+
+/**
+ * Reduction operations of Communicator::allreduce
+ */
+enum class ReduceOp {
+    MIN = 0,
+    MAX = 1,
+    SUM = 2,
+};
+
+/**
+ * Communication between the ranks of a parallel solver.
+ * The solvers only use these operations, so they run on MPI processes (MpiCommunicator)
+ * or on the threads of a single process (ThreadCommunicator) without changes.
+ * Collectives must be called by all ranks in the same order, messages are nonblocking and tagged.
+ */
+class Communicator {
+   public:
+    virtual ~Communicator() = default;
+
+    virtual int rank() const = 0;
+
+    virtual int size() const = 0;
+
+    virtual void barrier() = 0;
+
+    /**
+     * Reduce the values of all ranks element-wise, the result replaces the values on every rank
+     */
+    virtual void allreduce(double *values, int count, ReduceOp op) = 0;
+
+    virtual void allreduce(int *values, int count, ReduceOp op) = 0;
+
+    /**
+     * Copy the bytes of the root to all ranks
+     */
+    virtual void broadcast(void *data, size_t bytes, int root) = 0;
+
+    /**
+     * Gather the bytes of every rank, the block of rank r is at recv + r * bytes
+     */
+    virtual void allgather(const void *send, size_t bytes, void *recv) = 0;
+
+    /**
+     * Send a message without blocking, the message must not be changed afterwards
+     */
+    virtual void send(int dest, int tag, Message message) = 0;
+
+    /**
+     * Receive a message of the tag from any rank
+     * @param wait block until a message arrives
+     * @return the message, null if none arrived and wait is false
+     */
+    virtual Message receive(int tag, bool wait) = 0;
+
+    /**
+     * Block until the messages sent by this rank were delivered and their buffers released
+     */
+    virtual void complete_sends() = 0;
+
+    /**
+     * Wall clock time in seconds
+     */
+    static double wtime() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+/**
+ * Communicator of MPI processes
+ */
+class MpiCommunicator : public Communicator {
+   public:
+    explicit MpiCommunicator(MPI_Comm comm = MPI_COMM_WORLD) : comm(comm) {
+        MPI_Comm_rank(comm, &my_rank);
+        MPI_Comm_size(comm, &num_ranks);
+    }
+
+    ~MpiCommunicator() override {
+        int finalized;
+        MPI_Finalized(&finalized);
+        if (!finalized) {
+            complete_sends();
+        }
+    }
+
+    int rank() const override { return my_rank; }
+
+    int size() const override { return num_ranks; }
+
+    void barrier() override { MPI_Barrier(comm); }
+
+    void allreduce(double *values, int count, ReduceOp op) override { MPI_Allreduce(MPI_IN_PLACE, values, count, MPI_DOUBLE, mpi_op(op), comm); }
+
+    void allreduce(int *values, int count, ReduceOp op) override { MPI_Allreduce(MPI_IN_PLACE, values, count, MPI_INT, mpi_op(op), comm); }
+
+    void broadcast(void *data, size_t bytes, int root) override { MPI_Bcast(data, bytes, MPI_BYTE, root, comm); }
+
+    void allgather(const void *send, size_t bytes, void *recv) override { MPI_Allgather(send, bytes, MPI_BYTE, recv, bytes, MPI_BYTE, comm); }
+
+    void send(int dest, int tag, Message message) override {
+        release_completed();
+        MPI_Request request;
+        MPI_Isend(message->data(), message->size(), MPI_BYTE, dest, tag, comm, &request);
+        pending.push_back({request, std::move(message)});
+    }
+
+    Message receive(int tag, bool wait) override {
+        MPI_Status status;
+        int arrived = 1;
+        if (wait) {
+            MPI_Probe(MPI_ANY_SOURCE, tag, comm, &status);
+        } else {
+            MPI_Iprobe(MPI_ANY_SOURCE, tag, comm, &arrived, &status);
+        }
+        if (!arrived) {
+            return nullptr;
+        }
+        int bytes;
+        MPI_Get_count(&status, MPI_BYTE, &bytes);
+        auto message = std::make_shared<std::vector<char>>(bytes);
+        MPI_Recv(message->data(), bytes, MPI_BYTE, status.MPI_SOURCE, tag, comm, MPI_STATUS_IGNORE);
+        return message;
+    }
+
+    void complete_sends() override {
+        for (auto &[request, message] : pending) {
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        pending.clear();
+    }
+
+   private:
+    MPI_Comm comm;
+    int my_rank;
+    int num_ranks;
+    std::list<std::pair<MPI_Request, Message>> pending;  // Sends in flight and their buffers
+
+    void release_completed() {
+        for (auto it = pending.begin(); it != pending.end();) {
+            int done;
+            MPI_Test(&it->first, &done, MPI_STATUS_IGNORE);
+            it = done ? pending.erase(it) : std::next(it);
+        }
+    }
+
+    static MPI_Op mpi_op(ReduceOp op) {
+        switch (op) {
+            case ReduceOp::MIN:
+                return MPI_MIN;
+            case ReduceOp::MAX:
+                return MPI_MAX;
+            default:
+                return MPI_SUM;
+        }
+    }
+};
+
+/**
+ * State shared by the threads of a ThreadCommunicator: a spinning barrier on an atomic generation counter, one slot per rank
+ * publishing the buffer of a collective and one lock-free mailbox per rank.
+ * Collectives read the buffers of the other ranks directly between two barriers, so nothing is copied
+ * through a transport, and messages are passed as shared pointers without copying the data.
+ */
+class ThreadGroup {
+   public:
+    explicit ThreadGroup(int size) : num_ranks(size), slots(size), mailboxes(size) {}
+
+    ~ThreadGroup() {
+        for (Mailbox &mailbox : mailboxes) {
+            Node *node = mailbox.head.exchange(nullptr);
+            while (node) {
+                Node *next = node->next;
+                delete node;
+                node = next;
+            }
+        }
+    }
+
+    int size() const { return num_ranks; }
+
+    /**
+     * Run the function on size() threads, each with the communicator of its rank, and wait for all of them
+     */
+    void run(const std::function<void(Communicator &)> &function);
+
+   private:
+    friend class ThreadCommunicator;
+
+    struct Node {
+        int tag;
+        Message message;
+        Node *next;
+    };
+
+    // Multiple producers push with compare and swap, the owner takes the whole stack at once
+    struct Mailbox {
+        std::atomic<Node *> head{nullptr};
+    };
+
+    int num_ranks;
+    std::atomic<int> arrived{0};
+    std::atomic<int> generation{0};
+    std::vector<const void *> slots;
+    std::vector<Mailbox> mailboxes;
+
+    void barrier() {
+        int current = generation.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) == num_ranks - 1) {
+            arrived.store(0, std::memory_order_relaxed);
+            generation.store(current + 1, std::memory_order_release);
+            return;
+        }
+        while (generation.load(std::memory_order_acquire) == current) {
+            std::this_thread::yield();
+        }
+    }
+
+    void push(int dest, int tag, Message message) {
+        Node *node = new Node{tag, std::move(message), nullptr};
+        std::atomic<Node *> &head = mailboxes[dest].head;
+        node->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+/**
+ * Communicator of the threads of one process
+ */
+class ThreadCommunicator : public Communicator {
+   public:
+    ThreadCommunicator(ThreadGroup &group, int rank) : group(group), my_rank(rank) {}
+
+    int rank() const override { return my_rank; }
+
+    int size() const override { return group.size(); }
+
+    void barrier() override { group.barrier(); }
+
+    void allreduce(double *values, int count, ReduceOp op) override { reduce(values, count, op); }
+
+    void allreduce(int *values, int count, ReduceOp op) override { reduce(values, count, op); }
+
+    void broadcast(void *data, size_t bytes, int root) override {
+        publish(data);
+        if (my_rank != root) {
+            std::memcpy(data, group.slots[root], bytes);
+        }
+        group.barrier();  // the root buffer may change once all ranks copied it
+    }
+
+    void allgather(const void *send, size_t bytes, void *recv) override {
+        publish(send);
+        for (int r = 0; r < size(); r++) {
+            std::memcpy((char *)recv + r * bytes, group.slots[r], bytes);
+        }
+        group.barrier();
+    }
+
+    void send(int dest, int tag, Message message) override { group.push(dest, tag, std::move(message)); }
+
+    Message receive(int tag, bool wait) override {
+        while (true) {
+            // Take the messages pushed since the last call, the stack is reversed into arrival order
+            ThreadGroup::Node *node = group.mailboxes[my_rank].head.exchange(nullptr, std::memory_order_acquire);
+            std::list<std::pair<int, Message>> arrivals;
+            for (; node; node = next_and_delete(node)) {
+                arrivals.emplace_front(node->tag, std::move(node->message));
+            }
+            inbox.splice(inbox.end(), arrivals);
+            for (auto it = inbox.begin(); it != inbox.end(); it++) {
+                if (it->first == tag) {
+                    Message message = std::move(it->second);
+                    inbox.erase(it);
+                    return message;
+                }
+            }
+            if (!wait) {
+                return nullptr;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void complete_sends() override {}  // the messages are in the mailboxes as soon as they are sent
+
+   private:
+    ThreadGroup &group;
+    int my_rank;
+    std::list<std::pair<int, Message>> inbox;  // Received messages not taken yet, in arrival order
+
+    void publish(const void *data) {
+        group.slots[my_rank] = data;
+        group.barrier();
+    }
+
+    template <typename V>
+    void reduce(V *values, int count, ReduceOp op) {
+        publish(values);
+        std::vector<V> result(values, values + count);
+        for (int r = 0; r < size(); r++) {
+            const V *other = (const V *)group.slots[r];
+            for (int i = 0; i < count; i++) {
+                switch (op) {
+                    case ReduceOp::MIN:
+                        result[i] = std::min(result[i], other[i]);
+                        break;
+                    case ReduceOp::MAX:
+                        result[i] = std::max(result[i], other[i]);
+                        break;
+                    default:
+                        result[i] = r == 0 ? other[i] : result[i] + other[i];
+                        break;
+                }
+            }
+        }
+        group.barrier();  // every rank read the values of all the others before they are overwritten
+        std::copy(result.begin(), result.end(), values);
+    }
+
+    static ThreadGroup::Node *next_and_delete(ThreadGroup::Node *node) {
+        ThreadGroup::Node *next = node->next;
+        delete node;
+        return next;
+    }
+};
+
+inline void ThreadGroup::run(const std::function<void(Communicator &)> &function) {
+    std::vector<std::thread> threads;
+    for (int r = 0; r < num_ranks; r++) {
+        threads.emplace_back([this, r, &function]() {
+            ThreadCommunicator comm = ThreadCommunicator(*this, r);
+            function(comm);
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "neh_data_reader.hpp"
+#include "permutation.hpp"
+#include "shared_matrix.hpp"
+
+// Makespan of a permutation of jobs
+typedef std::function<int(const Permutation &)> FlowShopCostKernel;
+
+/**
+ * Flow shop makespan kernel for a size known at compile time.
+ * The processing times are kept in a fixed size array and the loop over the machines is fully unrolled.
+ * @tparam J the number of jobs
+ * @tparam M the number of machines
+ */
+template <int J, int M>
+class FixedFlowShopKernel {
+   public:
+    FixedFlowShopKernel(IntMatrixView tasks) {
+        for (int j = 0; j < J; j++) {
+            for (int m = 0; m < M; m++) {
+                times[j][m] = tasks[j][m];
+            }
+        }
+    }
+
+    int cost(const Permutation &candidate) const {
+        int completion[M] = {0};
+        for (int p = 0; p < J; p++) {
+            const int *job = times[candidate[p]];
+            completion[0] += job[0];
+#pragma GCC unroll 32
+            for (int m = 1; m < M; m++) {
+                completion[m] = std::max(completion[m - 1], completion[m]) + job[m];
+            }
+        }
+        return completion[M - 1];
+    }
+
+    /**
+     * Wrap the kernel in a cost function
+     */
+    static FlowShopCostKernel make(IntMatrixView tasks) {
+        auto kernel = std::make_shared<FixedFlowShopKernel<J, M>>(tasks);
+        return [kernel](const Permutation &candidate) { return kernel->cost(candidate); };
+    }
+
+   private:
+    int times[J][M];
+};
+
+/**
+ * Pick the makespan kernel specialized for the size of the instance (Taillard sizes),
+ * instances of other sizes use the generic loop.
+ * The specialized kernels keep their own copy of the processing times, the generic one reads the view.
+ * @param tasks processing times, tasks[job][machine]
+ */
+inline FlowShopCostKernel make_flow_shop_cost_kernel(IntMatrixView tasks) {
+    int jobs = tasks.size();
+    int machines = tasks.num_cols();
+#define FLOW_SHOP_KERNEL(J, M) \
+    if (jobs == J && machines == M) return FixedFlowShopKernel<J, M>::make(tasks);
+    FLOW_SHOP_KERNEL(20, 5)
+    FLOW_SHOP_KERNEL(20, 10)
+    FLOW_SHOP_KERNEL(20, 20)
+    FLOW_SHOP_KERNEL(50, 5)
+    FLOW_SHOP_KERNEL(50, 10)
+    FLOW_SHOP_KERNEL(50, 20)  // neh50_20
+#undef FLOW_SHOP_KERNEL
+
+    return [tasks, machines](const Permutation &candidate) {
+        std::vector<int> completion(machines, 0);
+        for (int p = 0; p < candidate.size(); p++) {
+            const int *job = tasks[candidate[p]];
+            completion[0] += job[0];
+            for (int m = 1; m < machines; m++) {
+                completion[m] = std::max(completion[m - 1], completion[m]) + job[m];
+            }
+        }
+        return completion[machines - 1];
+    };
+}
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "island_model.hpp"
+#include "permutation.hpp"
+#include "shared_matrix.hpp"
+
+#ifndef NO_EXCHANGE_PERIOD
+#define NO_EXCHANGE_PERIOD -1
+#endif
+#ifndef NO_TIME_LIMIT
+#define NO_TIME_LIMIT -1
+#endif
+
+/**
+ * Iterated Greedy for the permutation flow shop (Ruiz and Stützle).
+ * The start is the NEH sequence: the jobs sorted by decreasing total processing time, each inserted at its best position.
+ * Every iteration removes d random jobs from the current sequence (destruction), inserts them back one by one
+ * at their best positions (reconstruction) and improves the result by the insertion local search.
+ * The best insertion position of a job is found for all positions at once with the accelerations of Taillard,
+ * from the heads and tails of the partial sequence in O(L m) instead of O(L^2 m).
+ * A batch of destruction sets is tried in parallel, one per thread, and the best of the batch is accepted
+ * if it is better than the current sequence or by the constant temperature test of Ruiz and Stützle,
+ * T = temperature * sum of the processing times / (10 n m).
+ * With an island model every process is an island sending its best sequences to its neighbours.
+ */
+class IteratedGreedySolver {
+   public:
+    /**
+     * Constructor
+     * @param tasks processing times, tasks[job][machine], must outlive the solver
+     * @param on_new_best_solution called with the current sequence after every iteration
+     */
+    IteratedGreedySolver(IntMatrixView tasks, std::function<void(Permutation &, double)> on_new_best_solution)
+        : tasks(tasks), n(tasks.size()), machines(tasks.num_cols()), on_new_solution(on_new_best_solution) {}
+
+    /**
+     * Set the number of jobs removed by the destruction, 4 by default
+     */
+    void set_destruction(int d) { destruction = std::max(1, std::min(d, n - 1)); }
+
+    /**
+     * Set the factor of the acceptance temperature, 0.4 by default
+     */
+    void set_temperature(double factor) { temperature_factor = factor; }
+
+    /**
+     * Enable or disable the insertion local search after the reconstruction, enabled by default
+     */
+    void set_local_search(bool enabled) { local_search = enabled; }
+
+    /**
+     * Use the island model for the communication between processes
+     * @param island_model the island model, must outlive the calls to solve
+     */
+    void set_island_model(IslandModel<Permutation> *island_model) { this->island_model = island_model; }
+
+    /**
+     * Set the number of threads, every thread tries its own destruction set in each iteration, 1 by default
+     */
+    void set_threads(int num_threads) { this->num_threads = std::max(1, num_threads); }
+
+    /**
+     * Seed the destruction and the acceptance test, a random seed is used by default
+     * @param seed the seed, should differ between processes
+     */
+    void set_seed(unsigned seed) {
+        this->seed = seed;
+        seeded = true;
+    }
+
+    /**
+     * Solve the problem
+     * @param num_iter the number of iterations, each trying one destruction set per thread
+     * @param migration_period number of iterations between the migrations
+     * @param time_limit the time limit in seconds
+     * @return a pair of the best sequence and its makespan
+     */
+    std::pair<Permutation, double> solve(int num_iter, int migration_period = NO_EXCHANGE_PERIOD, double time_limit = NO_TIME_LIMIT) {
+        std::mt19937 gen(seeded ? seed : std::random_device()());
+        if (migration_period == NO_EXCHANGE_PERIOD) {
+            migration_period = num_iter;
+        }
+        long total = 0;
+        for (int j = 0; j < n; j++) {
+            for (int m = 0; m < machines; m++) {
+                total += tasks[j][m];
+            }
+        }
+        double temperature = temperature_factor * total / (10.0 * n * machines);
+
+        std::vector<Workspace> workspaces(num_threads);
+        std::vector<int> current = neh(workspaces[0]);
+        int current_cost = local_search ? improve(current, workspaces[0], gen) : makespan(current);
+        std::vector<int> best = current;
+        int best_cost = current_cost;
+        Permutation solution = to_permutation(current);
+        on_new_solution(solution, current_cost);
+
+        std::vector<std::vector<int>> candidates(num_threads);
+        std::vector<int> candidate_costs(num_threads);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double start = Communicator::wtime();
+        for (int i = 0; i < num_iter; i++) {
+            if (time_limit != NO_TIME_LIMIT && Communicator::wtime() - start > time_limit) {
+                break;
+            }
+            // The seeds are drawn by the process generator, so a run depends only on the seed and the number of threads
+            std::vector<unsigned> seeds(num_threads);
+            for (unsigned &s : seeds) {
+                s = gen();
+            }
+#pragma omp parallel for num_threads(num_threads) if (num_threads > 1)
+            for (int k = 0; k < num_threads; k++) {
+                std::mt19937 thread_gen(seeds[k]);
+                candidates[k] = current;
+                candidate_costs[k] = destroy_and_rebuild(candidates[k], workspaces[k], thread_gen);
+            }
+
+            // Best of the batch, accepted if better or by the temperature test
+            int k = std::min_element(candidate_costs.begin(), candidate_costs.end()) - candidate_costs.begin();
+            int delta = candidate_costs[k] - current_cost;
+            if (delta < 0 || uniform(gen) < std::exp(-delta / temperature)) {
+                current.swap(candidates[k]);
+                current_cost = candidate_costs[k];
+                if (current_cost < best_cost) {
+                    best = current;
+                    best_cost = current_cost;
+                }
+            }
+
+            solution = to_permutation(current);
+            if (island_model != nullptr) {
+                island_model->offer(solution, current_cost);
+                double migrant_cost = current_cost;
+                if (island_model->immigrate(solution, migrant_cost)) {
+                    current_cost = migrant_cost;
+                    current.assign(solution.data(), solution.data() + n);
+                    if (current_cost < best_cost) {
+                        best = current;
+                        best_cost = current_cost;
+                    }
+                }
+                if ((i + 1) % migration_period == 0) {
+                    island_model->emigrate();
+                }
+            }
+            on_new_solution(solution, current_cost);
+        }
+
+        if (island_model != nullptr) {
+            island_model->finish();
+        }
+
+        return {to_permutation(best), best_cost};
+    }
+
+   private:
+    /**
+     * Buffers of the Taillard insertion, (L + 1) x machines each
+     */
+    struct Workspace {
+        std::vector<int> heads;       // heads[i][m]: completion of the first i + 1 jobs on machine m
+        std::vector<int> tails;       // tails[i][m]: time from the start of job i on machine m to the end of the sequence
+        std::vector<int> insertions;  // insertions[i][m]: completion of the inserted job at position i on machine m
+        std::vector<int> removed;
+    };
+
+    IntMatrixView tasks;
+    int n;
+    int machines;
+    std::function<void(Permutation &, double)> on_new_solution;
+
+    int destruction = 4;
+    double temperature_factor = 0.4;
+    bool local_search = true;
+    IslandModel<Permutation> *island_model = nullptr;
+    int num_threads = 1;
+    unsigned seed = 0;
+    bool seeded = false;
+
+    Permutation to_permutation(const std::vector<int> &sequence) const {
+        std::vector<Permutation::value_type> values(sequence.begin(), sequence.end());
+        Permutation permutation(n);
+        permutation.unpack(values.data());
+        return permutation;
+    }
+
+    int makespan(const std::vector<int> &sequence) const {
+        std::vector<int> completion(machines, 0);
+        for (int job : sequence) {
+            completion[0] += tasks[job][0];
+            for (int m = 1; m < machines; m++) {
+                completion[m] = std::max(completion[m - 1], completion[m]) + tasks[job][m];
+            }
+        }
+        return completion[machines - 1];
+    }
+
+    /**
+     * Insert the job at its best position in the sequence (the first one on ties), Taillard's accelerations
+     * @return the makespan of the sequence with the job
+     */
+    int insert_best(std::vector<int> &sequence, int job, Workspace &w) const {
+        int length = sequence.size();
+        int M = machines;
+        w.heads.resize((size_t)(length + 1) * M);
+        w.tails.assign((size_t)(length + 1) * M, 0);
+        w.insertions.resize((size_t)(length + 1) * M);
+        for (int i = 0; i < length; i++) {
+            const int *p = tasks[sequence[i]];
+            int *e = &w.heads[(size_t)i * M];
+            const int *prev = i > 0 ? &w.heads[(size_t)(i - 1) * M] : nullptr;
+            for (int m = 0; m < M; m++) {
+                e[m] = std::max(prev ? prev[m] : 0, m > 0 ? e[m - 1] : 0) + p[m];
+            }
+        }
+        for (int i = length - 1; i >= 0; i--) {
+            const int *p = tasks[sequence[i]];
+            int *q = &w.tails[(size_t)i * M];
+            const int *next = &w.tails[(size_t)(i + 1) * M];
+            for (int m = M - 1; m >= 0; m--) {
+                q[m] = std::max(next[m], m < M - 1 ? q[m + 1] : 0) + p[m];
+            }
+        }
+        const int *p = tasks[job];
+        int best_position = 0;
+        int best = std::numeric_limits<int>::max();
+        for (int i = 0; i <= length; i++) {
+            int *f = &w.insertions[(size_t)i * M];
+            const int *e = i > 0 ? &w.heads[(size_t)(i - 1) * M] : nullptr;
+            const int *q = &w.tails[(size_t)i * M];
+            int span = 0;
+            for (int m = 0; m < M; m++) {
+                f[m] = std::max(e ? e[m] : 0, m > 0 ? f[m - 1] : 0) + p[m];
+                span = std::max(span, f[m] + q[m]);
+            }
+            if (span < best) {
+                best = span;
+                best_position = i;
+            }
+        }
+        sequence.insert(sequence.begin() + best_position, job);
+        return best;
+    }
+
+    /**
+     * NEH: the jobs by decreasing total processing time, each inserted at its best position
+     */
+    std::vector<int> neh(Workspace &w) const {
+        std::vector<int> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::vector<long> totals(n, 0);
+        for (int j = 0; j < n; j++) {
+            for (int m = 0; m < machines; m++) {
+                totals[j] += tasks[j][m];
+            }
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return totals[a] > totals[b]; });
+        std::vector<int> sequence;
+        sequence.reserve(n);
+        for (int job : order) {
+            insert_best(sequence, job, w);
+        }
+        return sequence;
+    }
+
+    /**
+     * Insertion local search: every job in a random order is removed and inserted at its best position,
+     * until a pass over all jobs does not improve the makespan
+     * @return the makespan of the improved sequence
+     */
+    int improve(std::vector<int> &sequence, Workspace &w, std::mt19937 &gen) const {
+        int cost = makespan(sequence);
+        std::vector<int> jobs = sequence;
+        bool improved = true;
+        while (improved) {
+            improved = false;
+            std::shuffle(jobs.begin(), jobs.end(), gen);
+            for (int job : jobs) {
+                sequence.erase(std::find(sequence.begin(), sequence.end(), job));
+                int new_cost = insert_best(sequence, job, w);
+                if (new_cost < cost) {
+                    cost = new_cost;
+                    improved = true;
+                }
+            }
+        }
+        return cost;
+    }
+
+    /**
+     * Remove random jobs and insert them back one by one at their best positions, then improve the sequence
+     * @return the makespan of the new sequence
+     */
+    int destroy_and_rebuild(std::vector<int> &sequence, Workspace &w, std::mt19937 &gen) const {
+        w.removed.clear();
+        for (int k = 0; k < destruction; k++) {
+            std::uniform_int_distribution<int> position(0, sequence.size() - 1);
+            int i = position(gen);
+            w.removed.push_back(sequence[i]);
+            sequence.erase(sequence.begin() + i);
+        }
+        int cost = 0;
+        for (int job : w.removed) {
+            cost = insert_best(sequence, job, w);
+        }
+        return local_search ? improve(sequence, w, gen) : cost;
+    }
+};
@@ -1,15 +1,64 @@
 #include <mpi.h>
+#ifdef _OPENMP
 #include <omp.h>
+#endif
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
+#include "communicator.hpp"
+#include "flow_shop_kernels.hpp"
+#include "genetic_solver.hpp"
+#include "iterated_greedy_solver.hpp"
 #include "neh_data_reader.hpp"
+#include "permutation.hpp"
+#include "racing_tuner.hpp"
 #include "rng.hpp"
+#include "shared_matrix.hpp"
 #include "simulated_annealing_solver.hpp"
+#include "solver_config.hpp"
 
-typedef std::vector<int> solution_t;
+typedef Permutation solution_t;
+
+// Options of a run, the same for all ranks
+struct RunOptions {
+    int n;
+    bool seeded;
+    unsigned seed;
+    std::string output;
+    int migrants;
+    int num_threads = 1;
+    std::string algorithm;
+    int num_iter;
+    double time_limit;
+    int exchange_period;
+    // Annealing
+    long cache_entries = 0;
+    std::string cooling;
+    double cooling_param;
+    double initial_temp;
+    // Iterated greedy
+    int destruction;
+    double ig_temperature;
+    bool local_search;
+    // Memetic algorithm
+    int population;
+    Crossover crossover;
+    int mutation_steps;
+    double mutation_temp;
+    double mutation_rate;
+};
+
+void tune(SolverConfig& config, int rank);
+void solve(Communicator& comm, const RunOptions& options, CostCache* cache, IntMatrixView tasks);
 
 int main(int argc, char** argv) {
     MPI_Init(&argc, &argv);
@@ -18,102 +67,377 @@ int main(int argc, char** argv) {
     int num_procs;
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
 
-    int n = 50;
-    int M = 20;
-    std::string filename = std::string("./data/neh50_20.dat");
+    SolverConfig config = SolverConfig(argc, argv, {"local-search", "print-config"});
+    if (config.has("tune-instances")) {
+        tune(config, rank);
+        MPI_Finalize();
+        return 0;
+    }
+
+    // The instance may also be given positionally as <n> <filename>,
+    // the dimensions are read from the header "<jobs> <machines>" of the file anyway
+    std::string filename = config.get_string("instance", config.positional(config.positional().size() > 1 ? 1 : 0, "./data/neh50_20.dat"));
+    int dimensions[2];
+    on_root(rank, [&]() {
+        std::vector<int> header = read_dimensions(filename, 2);
+        std::copy(header.begin(), header.end(), dimensions);
+    });
+    MPI_Bcast(dimensions, 2, MPI_INT, 0, MPI_COMM_WORLD);
+    int n = dimensions[0];
+    int M = dimensions[1];
+
+    // The instance is stored once per node and shared by all its processes
+    SharedMatrix<int> tasks(n, M);
+    {
+        IntMatrix times;
+        on_root(rank, [&]() {
+            NehDataReader reader = NehDataReader();
+            times = reader.fromDataFile(filename);
+        });
+        tasks.distribute(times);
+    }
+
+    // Options of the run, read once before the ranks start as the threads of the thread backend share them
+    RunOptions options;
+    options.n = n;
+    options.seeded = config.has("seed");
+    options.seed = config.get_int("seed", 0);
+    options.output = config.get_string("output", "./data_out");
+    options.migrants = config.get_int("migrants", 3);
+    options.algorithm = config.get_string("algorithm", "sa");
+    options.time_limit = config.get_double("time-limit", NO_TIME_LIMIT);
+    // The annealing (sa), the memetic algorithm (ga) or the iterated greedy (ig), only the options of the chosen one are read
+    if (options.algorithm == "ig") {
+        options.destruction = config.get_int("destruction", 4);
+        options.ig_temperature = config.get_double("ig-temperature", 0.4);
+        options.local_search = config.get_bool("local-search", true);
+        options.num_iter = config.get_int("iterations", 1000);
+        options.exchange_period = config.get_int("migration-period", 10);
+    } else if (options.algorithm == "ga") {
+        options.population = config.get_int("population", 50);
+        options.crossover = parse_crossover(config.get_string("crossover", "ox"));
+        options.mutation_steps = config.get_int("mutation-steps", 100);
+        options.mutation_temp = config.get_double("mutation-temp", 0.0);
+        options.mutation_rate = config.get_double("mutation-rate", 0.2);
+        options.num_iter = config.get_int("generations", 200);
+        options.exchange_period = config.get_int("migration-period", 10);
+    } else if (options.algorithm == "sa") {
+        // By default follow the acceptance rate schedule and reheat after 200 iterations without a new best solution
+        options.cooling = config.get_string("cooling", "reheat");
+        options.cooling_param = config.has("cooling-param") ? config.get_double("cooling-param", 0) : default_cooling_param(options.cooling);
+        options.num_iter = config.get_int("iterations", 1000);
+        std::string temp = config.get_string("initial-temp", "auto");
+        options.initial_temp = temp == "auto" ? AUTO_INITIAL_TEMP : std::stod(temp);
+        options.exchange_period = config.get_int("exchange-period", 120);
+        options.cache_entries = config.get_int("cost-cache", 4096);
+    } else {
+        throw std::runtime_error("Unknown algorithm " + options.algorithm);
+    }
 
-    IntMatrix tasks(n, std::vector<int>(n));
+    // The ranks are the MPI processes or, with the thread backend, the threads of this process
+    std::string backend = config.get_string("backend", "mpi");
+    int num_ranks = config.get_int("ranks", std::max(1u, std::thread::hardware_concurrency()));
+#ifdef _OPENMP
+    options.num_threads = config.get_int("threads", backend == "threads" ? 1 : omp_get_max_threads());
+#endif
 
+    bool print_config = config.get_bool("print-config", false);
     if (rank == 0) {
-        NehDataReader reader = NehDataReader();
-        tasks = reader.fromDataFile(filename);
+        for (const std::string& key : config.unused()) {
+            std::cerr << "Warning: unknown option --" << key << std::endl;
+        }
+        if (print_config) {
+            config.print(std::cout);
+        }
     }
 
-    for (int i = 0; i < n; i++) {
-        MPI_Bcast(tasks[i].data(), tasks[i].size(), MPI_INT, 0, MPI_COMM_WORLD);
+    // With the thread backend the ranks share one cache, so a solution evaluated by one rank is not evaluated by the others
+    std::unique_ptr<CostCache> cache;
+    if (options.algorithm == "sa" && options.cache_entries > 0) {
+        cache = std::make_unique<CostCache>(options.cache_entries);
     }
 
-    IntRNG swap = IntRNG(0, n - 1);
-    IntRNG with = IntRNG(0, n - 1);
+    if (backend == "threads") {
+        if (num_procs > 1) {
+            if (rank == 0) {
+                std::cerr << "The thread backend runs in a single process" << std::endl;
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        ThreadGroup group = ThreadGroup(num_ranks);
+        group.run([&](Communicator& comm) { solve(comm, options, cache.get(), tasks.view()); });
+    } else if (backend == "mpi") {
+        MpiCommunicator comm = MpiCommunicator(MPI_COMM_WORLD);
+        solve(comm, options, cache.get(), tasks.view());
+    } else {
+        throw std::runtime_error("Unknown backend " + backend);
+    }
+
+    tasks.release();
+    MPI_Finalize();
+    return 0;
+}
+
+/**
+ * Run the solver on one rank, all ranks of the communicator search the instance together
+ *
+ * @param comm the ranks
+ * @param options the options of the run
+ * @param cache the cache of the costs of the annealing, shared by the ranks of the thread backend, null disables it
+ * @param tasks the processing times of the jobs on the machines, shared by the ranks
+ */
+void solve(Communicator& comm, const RunOptions& options, CostCache* cache, IntMatrixView tasks) {
+    int rank = comm.rank();
+    int num_procs = comm.size();
+    int n = options.n;
+
+    // Every rank gets its own seed, so the runs are reproducible but the ranks do not search alike
+    bool seeded = options.seeded;
+    unsigned seed = options.seed + rank;
+    IntRNG swap = seeded ? IntRNG(0, n - 1, 2 * seed) : IntRNG(0, n - 1);
+    IntRNG with = seeded ? IntRNG(0, n - 1, 2 * seed + 1) : IntRNG(0, n - 1);
 
     std::function<void(solution_t&)> make_change = [&](solution_t& candidate) {
-        std::swap(candidate[swap.getNext()], candidate[with.getNext()]);
+        candidate.swap(swap.getNext(), with.getNext());
     };
 
+    std::function<void(solution_t&)> undo_change = [&](solution_t& candidate) {
+        candidate.undo();
+    };
+
+    // Kernel specialized for the size of the instance (generic loop for other sizes)
+    FlowShopCostKernel cost_kernel = make_flow_shop_cost_kernel(tasks);
     std::function<double(const solution_t&)> cost = [&](const solution_t& candidate) {
-        std::vector<int> Cmaxs(M, 0);
-        for (int p = 0; p < n; p++) {
-            int t_index = candidate[p] - 1;
-            for (int m = 0; m < M; m++) {
-                if (m != 0) {
-                    Cmaxs[m] = std::max(Cmaxs[m - 1], Cmaxs[m]) + tasks[t_index][m];
-                } else {
-                    Cmaxs[m] = Cmaxs[m] + tasks[t_index][m];
-                }
-            }
-        }
-        int maxCmax = *std::max_element(Cmaxs.begin(), Cmaxs.end());
-        return maxCmax;
+        return cost_kernel(candidate);
     };
 
     std::function<solution_t()> init_start_sol = [&]() {
         solution_t bestSolution = solution_t(n);
-        for (int i = 0; i < n; i++) {
-            bestSolution[i] = i + 1;
-        }
-        std::shuffle(bestSolution.begin(), bestSolution.end(), std::default_random_engine());
+        std::default_random_engine gen = seeded ? std::default_random_engine(seed) : std::default_random_engine();
+        bestSolution.shuffle(gen);
         return bestSolution;
     };
 
-    std::function<std::list<solution_t>(solution_t&)> exchange_solutions = [&](solution_t& candidate) {
-        solution_t globalSolutions = solution_t(n * num_procs);
-        MPI_Allgather(candidate.data(), n, MPI_INT, globalSolutions.data(), n, MPI_INT, MPI_COMM_WORLD);
-        std::list<solution_t> solutions = std::list<solution_t>();
+    // Every rank sends its best solution as a record of the hash, the cost and the values
+    std::function<std::list<std::pair<solution_t, double>>(solution_t&, double)> exchange_solutions = [&](solution_t& candidate, double candidate_cost) {
+        size_t record_bytes = sizeof(uint64_t) + sizeof(double) + solution_t::packed_bytes(n);
+        std::vector<char> record(record_bytes);
+        std::vector<char> records(record_bytes * num_procs);
+        uint64_t hash = candidate.hash();
+        std::memcpy(record.data(), &hash, sizeof(uint64_t));
+        std::memcpy(record.data() + sizeof(uint64_t), &candidate_cost, sizeof(double));
+        candidate.pack(record.data() + sizeof(uint64_t) + sizeof(double));
+        comm.allgather(record.data(), record_bytes, records.data());
+        std::list<std::pair<solution_t, double>> solutions;
         for (int j = 0; j < num_procs; j++) {
-            solution_t c = solution_t(globalSolutions.begin() + j * n, globalSolutions.begin() + (j + 1) * n);
-            solutions.push_back(c);
+            const char* other = records.data() + j * record_bytes;
+            double other_cost;
+            std::memcpy(&hash, other, sizeof(uint64_t));
+            std::memcpy(&other_cost, other + sizeof(uint64_t), sizeof(double));
+            solution_t c = solution_t(n);
+            c.unpack(other + sizeof(uint64_t) + sizeof(double), hash);
+            solutions.emplace_back(c, other_cost);
         }
         return solutions;
     };
 
+    // The costs and paths of the new solutions are written to <output>/cost and <output>/path
+    bool write_output = options.output != "none";
     std::ofstream f;
     std::ofstream f2;
-    auto f_name = "./data_out/cost/out_rank" + std::to_string(rank) + ".data";
-    auto f_name_2 = "./data_out/path/out_rank_solutions" + std::to_string(rank) + ".data";
-    f.open(f_name);
-    f2.open(f_name_2);
+    if (write_output) {
+        f.open(options.output + "/cost/out_rank" + std::to_string(rank) + ".data");
+        f2.open(options.output + "/path/out_rank_solutions" + std::to_string(rank) + ".data");
+    }
 
     std::function<void(solution_t&, double)> on_new_solution = [&](solution_t& new_solution, double new_cost) {
+        if (!write_output) {
+            return;
+        }
         f << new_cost << std::endl;
-        for (auto item : new_solution) {
-            f2 << item << ",";
+        for (int i = 0; i < new_solution.size(); i++) {
+            f2 << new_solution[i] + 1 << ",";
         }
         f2 << std::endl;
     };
 
-    // std::unique_ptr<CoolingStrategy> cooling_strategy = std::make_unique<GeometricCoolingStrategy>(0.996);
-    std::unique_ptr<CoolingStrategy> cooling_strategy = std::make_unique<LogarithmicCoolingStrategy>(0.001);
-    // std::unique_ptr<CoolingStrategy> cooling_strategy = std::make_unique<LinearCoolingStrategy>(100 / 1000 + 1);
-    SimmulatedAnnealingSolver<solution_t> solver = SimmulatedAnnealingSolver<solution_t>(cost, make_change, init_start_sol, exchange_solutions, std::move(cooling_strategy), on_new_solution);
+    // Send the best solutions with their costs along a ring instead of gathering the solutions of all ranks
+    IslandModel<solution_t> island_model = IslandModel<solution_t>(n, options.migrants, MigrationTopology::RING, ReplacementPolicy::REPLACE_IF_BETTER, comm);
+
+    std::unique_ptr<SimmulatedAnnealingSolver<solution_t>> annealing;
+    std::unique_ptr<GeneticSolver<solution_t>> genetic;
+    std::unique_ptr<IteratedGreedySolver> greedy;
+    if (options.algorithm == "ig") {
+        greedy = std::make_unique<IteratedGreedySolver>(tasks, on_new_solution);
+        greedy->set_destruction(options.destruction);
+        greedy->set_temperature(options.ig_temperature);
+        greedy->set_local_search(options.local_search);
+        greedy->set_island_model(&island_model);
+        // Every thread tries its own destruction set, the best of the batch is accepted
+        greedy->set_threads(options.num_threads);
+        if (seeded) {
+            greedy->set_seed(seed);
+        }
+    } else if (options.algorithm == "ga") {
+        genetic = std::make_unique<GeneticSolver<solution_t>>(n, options.population, cost, init_start_sol, options.crossover, on_new_solution);
+        // The children are improved by a short annealing, at temperature 0 by a local search
+        std::function<void(solution_t&, std::mt19937&)> random_move = [n](solution_t& candidate, std::mt19937& gen) {
+            std::uniform_int_distribution<int> position(0, n - 1);
+            candidate.swap(position(gen), position(gen));
+        };
+        genetic->set_annealing_mutation(random_move, undo_change, options.mutation_steps, options.mutation_temp, options.mutation_rate);
+        genetic->set_island_model(&island_model);
+        genetic->set_threads(options.num_threads);
+        if (seeded) {
+            genetic->set_seed(seed);
+        }
+    } else {
+        annealing = std::make_unique<SimmulatedAnnealingSolver<solution_t>>(cost, make_change, init_start_sol, exchange_solutions, make_cooling_strategy(options.cooling, options.cooling_param), on_new_solution);
+        annealing->set_island_model(&island_model);
+        annealing->set_undo_change(undo_change);
+        if (cache) {
+            annealing->set_cost_cache(cache, [](const solution_t& candidate) { return candidate.hash(); });
+        }
+        if (seeded) {
+            annealing->set_seed(seed);
+        }
+        // Evaluate that many moves at once, the first accepted one is made
+        annealing->set_speculative_threads(options.num_threads);
+    }
 
-    double s = MPI_Wtime();
-    auto solution = solver.solve(1000, 100, 120, NO_TIME_LIMIT);
-    std::cout << "RANK[" << rank << "] " << "Time: " << MPI_Wtime() - s << std::endl;
-    MPI_Barrier(MPI_COMM_WORLD);
+    double s = Communicator::wtime();
+    std::pair<solution_t, double> solution;
+    if (greedy) {
+        solution = greedy->solve(options.num_iter, options.exchange_period, options.time_limit);
+    } else if (genetic) {
+        solution = genetic->solve(options.num_iter, options.exchange_period, options.time_limit);
+    } else {
+        solution = annealing->solve(options.num_iter, options.initial_temp, options.exchange_period, options.time_limit);
+    }
+    std::stringstream report;
+    report << "RANK[" << rank << "] " << "Time: " << Communicator::wtime() - s;
+    if (annealing && cache) {
+        auto [lookups, hits] = annealing->cache_statistics();
+        report << " Cache hits: " << hits << "/" << lookups << " (" << 100.0 * hits / std::max(1L, lookups) << "%)";
+    }
+    report << std::endl;
+    std::cout << report.str();
+    comm.barrier();
 
-    double bestSolution;
-    MPI_Allreduce(&solution.second, &bestSolution, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+    double bestSolution = solution.second;
+    comm.allreduce(&bestSolution, 1, ReduceOp::MIN);
     if (bestSolution == solution.second) {
-        std::cout << "Solution: ";
-        for (auto val : solution.first) {
-            std::cout << val << " ";
+        std::stringstream result;
+        result << "Solution: ";
+        for (int i = 0; i < solution.first.size(); i++) {
+            result << solution.first[i] + 1 << " ";
         }
-        std::cout << std::endl;
+        result << std::endl;
 
-        std::cout << "Cost: " << solution.second << std::endl;
+        result << "Cost: " << solution.second << std::endl;
+        std::cout << result.str();
     }
 
     f.close();
-    MPI_Finalize();
-    return 0;
+    f2.close();
+}
+
+/**
+ * Race parameter configurations of the annealing on a class of instances and print the best one
+ * in the config file format. Every process evaluates its share of the configurations alone (without migration),
+ * the exchange period is then the period of the restarts from the best solution of the chain.
+ *
+ * @param config the options, --tune-instances <instance,instance,...> and the tuning options
+ * @param rank the rank of the process
+ */
+void tune(SolverConfig& config, int rank) {
+    std::vector<std::string> filenames;
+    std::stringstream list(config.get_string("tune-instances", ""));
+    for (std::string filename; std::getline(list, filename, ',');) {
+        filenames.push_back(filename);
+    }
+
+    // The instances are stored once per node and shared by all its processes
+    std::vector<std::unique_ptr<SharedMatrix<int>>> instances;
+    for (std::string& filename : filenames) {
+        IntMatrix times;
+        int dimensions[2];
+        on_root(rank, [&]() {
+            std::vector<int> header = read_dimensions(filename, 2);
+            std::copy(header.begin(), header.end(), dimensions);
+            NehDataReader reader = NehDataReader();
+            times = reader.fromDataFile(filename);
+        });
+        MPI_Bcast(dimensions, 2, MPI_INT, 0, MPI_COMM_WORLD);
+        instances.push_back(std::make_unique<SharedMatrix<int>>(dimensions[0], dimensions[1]));
+        instances.back()->distribute(times);
+    }
+
+    int num_iter = config.get_int("iterations", 1000);
+    std::string cooling = config.get_string("cooling", "geometric");
+    std::vector<TunedParameter> parameters = {
+        with_range({"initial-temp", 1, 10000, false, true}, config.get_string("tune-initial-temp", "")),
+        with_range({"exchange-period", 10, 500, true, false}, config.get_string("tune-exchange-period", "")),
+    };
+    // Range of the parameter of the cooling strategy, lam has none
+    if (cooling == "geometric") {
+        parameters.push_back(with_range({"cooling-param", 0.9, 0.9999}, config.get_string("tune-cooling-param", "")));
+    } else if (cooling == "linear" || cooling == "logarithmic") {
+        parameters.push_back(with_range({"cooling-param", 0.0001, 10, false, true}, config.get_string("tune-cooling-param", "")));
+    } else if (cooling == "reheat") {
+        parameters.push_back(with_range({"cooling-param", 50, 1000, true, false}, config.get_string("tune-cooling-param", "")));
+    }
+
+    RacingTuner::Evaluation evaluate = [&](const ParameterConfiguration& configuration, int instance, unsigned seed) {
+        IntMatrixView tasks = instances[instance]->view();
+        int n = tasks.size();
+        IntRNG swap = IntRNG(0, n - 1, 2 * seed);
+        IntRNG with = IntRNG(0, n - 1, 2 * seed + 1);
+        FlowShopCostKernel cost_kernel = make_flow_shop_cost_kernel(tasks);
+
+        std::function<double(const solution_t&)> cost = [&](const solution_t& candidate) { return cost_kernel(candidate); };
+        std::function<void(solution_t&)> make_change = [&](solution_t& candidate) { candidate.swap(swap.getNext(), with.getNext()); };
+        std::function<void(solution_t&)> undo_change = [&](solution_t& candidate) { candidate.undo(); };
+        std::function<solution_t()> init_start_sol = [&]() {
+            solution_t start = solution_t(n);
+            std::default_random_engine gen = std::default_random_engine(seed);
+            start.shuffle(gen);
+            return start;
+        };
+        std::function<std::list<std::pair<solution_t, double>>(solution_t&, double)> keep_best = [](solution_t& candidate, double candidate_cost) { return std::list<std::pair<solution_t, double>>{{candidate, candidate_cost}}; };
+        std::function<void(solution_t&, double)> ignore_solution = [](solution_t&, double) {};
+
+        double cooling_param = configuration.count("cooling-param") ? configuration.at("cooling-param") : 0;
+        SimmulatedAnnealingSolver<solution_t> solver = SimmulatedAnnealingSolver<solution_t>(cost, make_change, init_start_sol, keep_best, make_cooling_strategy(cooling, cooling_param), ignore_solution);
+        solver.set_undo_change(undo_change);
+        solver.set_seed(seed);
+        return solver.solve(num_iter, configuration.at("initial-temp"), configuration.at("exchange-period")).second;
+    };
+
+    RacingTuner tuner = RacingTuner(parameters);
+    tuner.set_confidence(config.get_double("tune-confidence", 0.95));
+    tuner.set_first_test(config.get_int("tune-first-test", 5));
+    int num_candidates = config.get_int("tune-candidates", 20);
+    int budget = config.get_int("tune-budget", 400);
+    unsigned seed = config.get_int("seed", 0);
+    if (rank == 0) {
+        for (const std::string& key : config.unused()) {
+            std::cerr << "Warning: unknown option --" << key << std::endl;
+        }
+    }
+    ParameterConfiguration best = tuner.race(num_candidates, budget, filenames.size(), evaluate, seed);
+    tuner.print(std::cout);
+
+    if (rank == 0) {
+        std::cout << "# Best configuration" << std::endl;
+        std::cout << "cooling = " << cooling << std::endl;
+        std::cout << "iterations = " << num_iter << std::endl;
+        for (auto& [name, value] : best) {
+            std::cout << name << " = " << value << std::endl;
+        }
+    }
+
+    for (auto& instance : instances) {
+        instance->release();
+    }
 }
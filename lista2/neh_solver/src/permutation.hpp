@@ -0,0 +1,209 @@
+#pragma once
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Permutation of 0..n-1 stored in a compact integer type together with its inverse.
+ * Moves are applied in place and the last one can be undone without copying the permutation.
+ * A Zobrist hash, the xor of a key of every (value, position) pair, is kept up to date by the moves,
+ * a swap changes it in O(1), so equal permutations can be recognized without comparing or evaluating them.
+ * @tparam Index the storage type, uint16_t halves the memory traffic of int for n < 65536
+ */
+template <typename Index>
+class BasicPermutation {
+   public:
+    typedef Index value_type;
+
+    /**
+     * Types of the moves that can be undone
+     */
+    enum class MoveType {
+        NONE = 0,
+        SWAP = 1,
+        INSERT = 2,
+    };
+
+    BasicPermutation() {}
+
+    /**
+     * Create the identity permutation
+     * @param n the size of the permutation
+     */
+    explicit BasicPermutation(int n) : values(n), positions(n) {
+        if (n > (int)std::numeric_limits<Index>::max() + 1) {
+            throw std::runtime_error("Permutation too large for its index type");
+        }
+        for (int i = 0; i < n; i++) {
+            values[i] = i;
+            positions[i] = i;
+        }
+        rehash();
+    }
+
+    int size() const { return values.size(); }
+
+    /**
+     * Get the value at the position
+     */
+    int operator[](int position) const { return values[position]; }
+
+    /**
+     * Get the position of the value (inverse permutation)
+     */
+    int position(int value) const { return positions[value]; }
+
+    const Index *data() const { return values.data(); }
+
+    /**
+     * Zobrist hash of the permutation, the same for equal permutations in every process
+     */
+    uint64_t hash() const { return zobrist; }
+
+    /**
+     * Swap the values at positions i and j
+     */
+    void swap(int i, int j) {
+        zobrist ^= zobrist_key(values[i], i) ^ zobrist_key(values[j], j) ^ zobrist_key(values[i], j) ^ zobrist_key(values[j], i);
+        std::swap(values[i], values[j]);
+        positions[values[i]] = i;
+        positions[values[j]] = j;
+        last_move = {MoveType::SWAP, i, j};
+    }
+
+    /**
+     * Remove the value at position from and insert it at position to, shifting the values in between
+     */
+    void insert(int from, int to) {
+        move_value(from, to);
+        last_move = {MoveType::INSERT, from, to};
+    }
+
+    /**
+     * Undo the last swap or insert
+     */
+    void undo() {
+        switch (last_move.type) {
+            case MoveType::SWAP:
+                swap(last_move.a, last_move.b);
+                break;
+            case MoveType::INSERT:
+                move_value(last_move.b, last_move.a);
+                break;
+            default:
+                break;
+        }
+        last_move = {MoveType::NONE, 0, 0};
+    }
+
+    /**
+     * Shuffle the permutation
+     * @param gen the random engine
+     */
+    template <typename Generator>
+    void shuffle(Generator &gen) {
+        std::shuffle(values.begin(), values.end(), gen);
+        rebuild_positions();
+        rehash();
+    }
+
+    /**
+     * Number of bytes taken by a packed permutation of size n
+     */
+    static size_t packed_bytes(int n) { return n * sizeof(Index); }
+
+    /**
+     * The MPI type of a single packed value
+     */
+    static MPI_Datatype mpi_type() {
+        if (std::is_same<Index, uint16_t>::value) return MPI_UINT16_T;
+        if (std::is_same<Index, uint32_t>::value) return MPI_UINT32_T;
+        return MPI_INT;
+    }
+
+    /**
+     * Copy the values into a communication buffer
+     */
+    void pack(void *buffer) const { std::memcpy(buffer, values.data(), packed_bytes(size())); }
+
+    /**
+     * Read the values from a communication buffer, the size of the permutation is kept
+     */
+    void unpack(const void *buffer) {
+        unpack(buffer, 0);
+        rehash();
+    }
+
+    /**
+     * Read the values from a communication buffer together with their hash, sent along so it is not computed again
+     */
+    void unpack(const void *buffer, uint64_t hash) {
+        std::memcpy(values.data(), buffer, packed_bytes(size()));
+        rebuild_positions();
+        zobrist = hash;
+        last_move = {MoveType::NONE, 0, 0};
+    }
+
+    bool operator==(const BasicPermutation &other) const { return values == other.values; }
+
+   private:
+    struct Move {
+        MoveType type;
+        int a;
+        int b;
+    };
+
+    std::vector<Index> values;
+    std::vector<Index> positions;
+    Move last_move = {MoveType::NONE, 0, 0};
+    uint64_t zobrist = 0;
+
+    /**
+     * Key of the value at the position. The keys are mixed from the pair (splitmix64) instead of drawn into
+     * an n x n table, so all permutations share them without memory and they agree between processes.
+     */
+    static uint64_t zobrist_key(int value, int position) {
+        uint64_t z = ((uint64_t)value << 32 | (uint32_t)position) + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    void rehash() {
+        zobrist = 0;
+        for (int i = 0; i < size(); i++) {
+            zobrist ^= zobrist_key(values[i], i);
+        }
+    }
+
+    void move_value(int from, int to) {
+        // Only the values in between change their positions
+        for (int i = std::min(from, to); i <= std::max(from, to); i++) {
+            zobrist ^= zobrist_key(values[i], i);
+        }
+        if (from < to) {
+            std::rotate(values.begin() + from, values.begin() + from + 1, values.begin() + to + 1);
+        } else {
+            std::rotate(values.begin() + to, values.begin() + from, values.begin() + from + 1);
+        }
+        for (int i = std::min(from, to); i <= std::max(from, to); i++) {
+            positions[values[i]] = i;
+            zobrist ^= zobrist_key(values[i], i);
+        }
+    }
+
+    void rebuild_positions() {
+        for (int i = 0; i < size(); i++) {
+            positions[values[i]] = i;
+        }
+    }
+};
+
+typedef BasicPermutation<uint16_t> Permutation;
@@ -0,0 +1,61 @@
+#include "lap_solver.hpp"
+
+#include <cstddef>
+#include <limits>
+
+long long LapSolver::solve(const std::vector<int> &cost, int n) {
+    const long long INF = std::numeric_limits<long long>::max() / 4;
+    // 1-based, column 0 is the virtual column the augmenting paths start from
+    u.assign(n + 1, 0);
+    v.assign(n + 1, 0);
+    p.assign(n + 1, 0);
+    way.assign(n + 1, 0);
+    for (int i = 1; i <= n; i++) {
+        p[0] = i;
+        int j0 = 0;
+        minv.assign(n + 1, INF);
+        used.assign(n + 1, false);
+        do {
+            used[j0] = true;
+            int i0 = p[j0], j1 = 0;
+            long long delta = INF;
+            const int *row = cost.data() + (size_t)(i0 - 1) * n;
+            for (int j = 1; j <= n; j++) {
+                if (!used[j]) {
+                    long long cur = row[j - 1] - u[i0] - v[j];
+                    if (cur < minv[j]) {
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if (minv[j] < delta) {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+            }
+            for (int j = 0; j <= n; j++) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        // Augment along the path
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0);
+    }
+
+    assignment.assign(n, -1);
+    for (int j = 1; j <= n; j++) {
+        if (p[j] > 0) {
+            assignment[p[j] - 1] = j - 1;
+        }
+    }
+    return -v[0];
+}
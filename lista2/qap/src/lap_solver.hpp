@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+
+/**
+ * Solver of the linear assignment problem (Hungarian method with potentials, shortest augmenting paths as in Jonker-Volgenant).
+ * O(n^3), the buffers are kept between the calls so solving many small problems does not allocate.
+ */
+class LapSolver {
+   public:
+    /**
+     * Find the assignment of rows to columns with the minimal total cost
+     * @param cost the n x n cost matrix, row-major
+     * @param n the size of the problem
+     * @return the minimal total cost
+     */
+    long long solve(const std::vector<int> &cost, int n);
+
+    /**
+     * Column assigned to each row by the last solve
+     */
+    const std::vector<int> &get_assignment() const { return assignment; }
+
+   private:
+    std::vector<long long> u;     // Potentials of the rows
+    std::vector<long long> v;     // Potentials of the columns
+    std::vector<long long> minv;  // Shortest reduced path to each column
+    std::vector<int> p;           // Row matched to each column
+    std::vector<int> way;         // Previous column on the shortest path
+    std::vector<char> used;
+    std::vector<int> assignment;
+};
@@ -1,57 +1,127 @@
 #include <mpi.h>
 
+#include <ctime>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <tuple>
 #include <vector>
 
 #include "qap_data_reader.hpp"
-#include "qap_solver.hpp"
+#include "qap_runner.hpp"
+#include "shared_matrix.hpp"
+#include "solver_config.hpp"
+
+void print_best(const std::pair<SolutionCandidate, int> &solution, double cpu_time);
 
 int main(int argc, char** argv) {
-    MPI_Init(&argc, &argv);
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);  // bnb calls MPI from the first thread only
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-    if (argc < 2) {
+    if (provided < MPI_THREAD_FUNNELED) {
         if (rank == 0) {
-            std::cout << "Usage: " << argv[0] << " <n> <filename>" << std::endl;
+            std::cerr << "Error: the MPI library does not support MPI_THREAD_FUNNELED" << std::endl;
         }
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
-    int n = std::stoi(argv[1]);
-    std::string filename = std::string(argv[2]);
-    IntMatrix flowMatrix(n, std::vector<int>(n));
-    IntMatrix distanceMatrix(n, std::vector<int>(n));
+    // Parameters from the command line and the optional config file, the positional form is still accepted
+    SolverConfig config = SolverConfig(argc, argv, {"print-config"});
+    if (config.has("jobs")) {
+        // Batch mode, every job of the manifest is solved by a group of processes
+        std::string manifest = config.get_string("jobs", "");
+        std::string results_file = config.get_string("results", config.positional(0, "results.csv"));
+        int ranks_per_job = config.get_int("ranks-per-job", std::stoi(config.positional(1, "1")));
+        QapJobRunner runner = QapJobRunner(read_manifest(manifest), ranks_per_job);
+        runner.run(results_file);
+        MPI_Finalize();
+        return 0;
+    }
 
+    std::string filename = config.get_string("instance", config.positional(1, ""));
+    if (filename.empty()) {
+        if (rank == 0) {
+            std::cout << "Usage: " << argv[0] << " <n> <filename> [sa|rts|ils|bnb] [time limit]" << std::endl;
+            std::cout << "       " << argv[0] << " --instance <filename> [--config <file>] [--solver sa|rts|ils|bnb] [--time-limit 10] [--iterations <n>] [--seed <seed>] [--print-config]" << std::endl;
+            std::cout << "       " << argv[0] << " --jobs <manifest> <results.csv> [ranks per job]" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    QapRunConfig run_config;
+    run_config.solver = config.get_string("solver", config.positional(2, "sa"));
+    run_config.time_limit = config.get_double("time-limit", std::stod(config.positional(3, "10")));
+    run_config.max_iter = config.get_int("iterations", 0);
+    run_config.seeded = config.has("seed");
+    run_config.seed = config.get_int("seed", 0);
+    bool print_config = config.get_bool("print-config", false);
     if (rank == 0) {
-        QapDataReader reader = QapDataReader();
-        auto [n, f, d] = reader.fromDataFile(filename);
-        flowMatrix = f;
-        distanceMatrix = d;
+        for (const std::string &key : config.unused()) {
+            std::cerr << "Warning: unknown option --" << key << std::endl;
+        }
+        if (print_config) {
+            config.print(std::cout);
+        }
     }
 
-    for (int i = 0; i < n; i++) {
-        MPI_Bcast(flowMatrix[i].data(), flowMatrix[i].size(), MPI_INT, 0, MPI_COMM_WORLD);
-        MPI_Bcast(distanceMatrix[i].data(), distanceMatrix[i].size(), MPI_INT, 0, MPI_COMM_WORLD);
+    int n;
+    on_root(rank, [&]() {
+        n = read_dimensions(filename, 1)[0];  // The size of the instance is read from the file
+    });
+    MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    // The instance is stored once per node and shared by all its processes
+    SharedMatrix<int> flowMatrix(n, n);
+    SharedMatrix<int> distanceMatrix(n, n);
+    {
+        IntMatrix f, d;
+        on_root(rank, [&]() {
+            QapDataReader reader = QapDataReader();
+            std::tie(std::ignore, f, d) = reader.fromDataFile(filename);
+        });
+        flowMatrix.distribute(f);
+        distanceMatrix.distribute(d);
     }
 
-    QapSolver solver = QapSolver(distanceMatrix, flowMatrix, 0.997);
-    auto solution = solver.solve(1000, n, 100, 100);
+    std::clock_t cpu_start = std::clock();
+    std::pair<SolutionCandidate, int> solution = run_qap_solver(run_config, distanceMatrix.view(), flowMatrix.view(), MPI_COMM_WORLD);
+    double cpu_time = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
 
-    int bestSolution;
+    print_best(solution, cpu_time);
 
+    flowMatrix.release();
+    distanceMatrix.release();
+    MPI_Finalize();
+    return 0;
+}
+
+/**
+ * Reduce the results of all processes and print the best one
+ *
+ * @param solution the solution and the cost found by this process
+ * @param cpu_time the cpu time used by this process in seconds, the sum over all processes is printed
+ */
+void print_best(const std::pair<SolutionCandidate, int> &solution, double cpu_time) {
+    int bestSolution;
+    double total_cpu_time;
     MPI_Allreduce(&solution.second, &bestSolution, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
-    if (bestSolution == solution.second) {
+    MPI_Allreduce(&cpu_time, &total_cpu_time, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+    // Only the lowest rank with the best cost prints
+    int rank;
+    int printing_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int candidate_rank = bestSolution == solution.second ? rank : std::numeric_limits<int>::max();
+    MPI_Allreduce(&candidate_rank, &printing_rank, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (rank == printing_rank) {
         std::cout << "Solution: ";
-        for (auto val : solution.first) {
-            std::cout << val << " ";
+        for (int i = 0; i < solution.first.size(); i++) {
+            std::cout << solution.first[i] + 1 << " ";
         }
         std::cout << std::endl;
 
         std::cout << "Cost: " << solution.second << std::endl;
+        std::cout << "CPU time: " << total_cpu_time << "s" << std::endl;
     }
-
-    MPI_Finalize();
-    return 0;
-}
\ No newline at end of file
+}
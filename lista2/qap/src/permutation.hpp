@@ -0,0 +1,166 @@
+#pragma once
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Permutation of 0..n-1 stored in a compact integer type together with its inverse.
+ * Moves are applied in place and the last one can be undone without copying the permutation.
+ * @tparam Index the storage type, uint16_t halves the memory traffic of int for n < 65536
+ */
+template <typename Index>
+class BasicPermutation {
+   public:
+    typedef Index value_type;
+
+    /**
+     * Types of the moves that can be undone
+     */
+    enum class MoveType {
+        NONE = 0,
+        SWAP = 1,
+        INSERT = 2,
+    };
+
+    BasicPermutation() {}
+
+    /**
+     * Create the identity permutation
+     * @param n the size of the permutation
+     */
+    explicit BasicPermutation(int n) : values(n), positions(n) {
+        if (n > (int)std::numeric_limits<Index>::max() + 1) {
+            throw std::runtime_error("Permutation too large for its index type");
+        }
+        for (int i = 0; i < n; i++) {
+            values[i] = i;
+            positions[i] = i;
+        }
+    }
+
+    int size() const { return values.size(); }
+
+    /**
+     * Get the value at the position
+     */
+    int operator[](int position) const { return values[position]; }
+
+    /**
+     * Get the position of the value (inverse permutation)
+     */
+    int position(int value) const { return positions[value]; }
+
+    const Index *data() const { return values.data(); }
+
+    /**
+     * Swap the values at positions i and j
+     */
+    void swap(int i, int j) {
+        std::swap(values[i], values[j]);
+        positions[values[i]] = i;
+        positions[values[j]] = j;
+        last_move = {MoveType::SWAP, i, j};
+    }
+
+    /**
+     * Remove the value at position from and insert it at position to, shifting the values in between
+     */
+    void insert(int from, int to) {
+        move_value(from, to);
+        last_move = {MoveType::INSERT, from, to};
+    }
+
+    /**
+     * Undo the last swap or insert
+     */
+    void undo() {
+        switch (last_move.type) {
+            case MoveType::SWAP:
+                swap(last_move.a, last_move.b);
+                break;
+            case MoveType::INSERT:
+                move_value(last_move.b, last_move.a);
+                break;
+            default:
+                break;
+        }
+        last_move = {MoveType::NONE, 0, 0};
+    }
+
+    /**
+     * Shuffle the permutation
+     * @param gen the random engine
+     */
+    template <typename Generator>
+    void shuffle(Generator &gen) {
+        std::shuffle(values.begin(), values.end(), gen);
+        rebuild_positions();
+    }
+
+    /**
+     * Number of bytes taken by a packed permutation of size n
+     */
+    static size_t packed_bytes(int n) { return n * sizeof(Index); }
+
+    /**
+     * The MPI type of a single packed value
+     */
+    static MPI_Datatype mpi_type() {
+        if (std::is_same<Index, uint16_t>::value) return MPI_UINT16_T;
+        if (std::is_same<Index, uint32_t>::value) return MPI_UINT32_T;
+        return MPI_INT;
+    }
+
+    /**
+     * Copy the values into a communication buffer
+     */
+    void pack(void *buffer) const { std::memcpy(buffer, values.data(), packed_bytes(size())); }
+
+    /**
+     * Read the values from a communication buffer, the size of the permutation is kept
+     */
+    void unpack(const void *buffer) {
+        std::memcpy(values.data(), buffer, packed_bytes(size()));
+        rebuild_positions();
+        last_move = {MoveType::NONE, 0, 0};
+    }
+
+    bool operator==(const BasicPermutation &other) const { return values == other.values; }
+
+   private:
+    struct Move {
+        MoveType type;
+        int a;
+        int b;
+    };
+
+    std::vector<Index> values;
+    std::vector<Index> positions;
+    Move last_move = {MoveType::NONE, 0, 0};
+
+    void move_value(int from, int to) {
+        if (from < to) {
+            std::rotate(values.begin() + from, values.begin() + from + 1, values.begin() + to + 1);
+        } else {
+            std::rotate(values.begin() + to, values.begin() + from, values.begin() + from + 1);
+        }
+        for (int i = std::min(from, to); i <= std::max(from, to); i++) {
+            positions[values[i]] = i;
+        }
+    }
+
+    void rebuild_positions() {
+        for (int i = 0; i < size(); i++) {
+            positions[values[i]] = i;
+        }
+    }
+};
+
+typedef BasicPermutation<uint16_t> Permutation;
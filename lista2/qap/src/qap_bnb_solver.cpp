@@ -0,0 +1,355 @@
+#include "qap_bnb_solver.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <thread>
+
+QapBranchAndBound::QapBranchAndBound(IntMatrixView distanceMatrix, IntMatrixView flowMatrix, MPI_Comm comm)
+    : distanceMatrix(distanceMatrix), flowMatrix(flowMatrix), evaluator(this->distanceMatrix, this->flowMatrix), comm(comm) {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+    n = distanceMatrix.size();
+
+    // Facilities with the largest flows first, their placement decides most of the cost
+    std::vector<long long> total_flow(n, 0);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            total_flow[i] += flowMatrix[i][j] + flowMatrix[j][i];
+        }
+    }
+    order = std::vector<int>(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return total_flow[a] > total_flow[b]; });
+
+    sorted_flows = std::vector<std::vector<std::vector<int>>>(n + 1, std::vector<std::vector<int>>(n));
+    for (int k = 0; k < n; k++) {
+        for (int a = k; a < n; a++) {
+            int i = order[a];
+            std::vector<int> &flows = sorted_flows[k][i];
+            for (int b = k; b < n; b++) {
+                if (b != a) {
+                    flows.push_back(flowMatrix[i][order[b]]);
+                }
+            }
+            std::sort(flows.begin(), flows.end());
+        }
+    }
+}
+
+void QapBranchAndBound::set_threads(int num_threads) {
+    this->num_threads = std::max(1, num_threads);
+}
+
+std::pair<SolutionCandidate, int> QapBranchAndBound::solve(const SolutionCandidate &start, double time_limit) {
+    incumbent = start;
+    own_cost = evaluator.cost(start);
+    incumbent_cost = own_cost;
+    last_sent = std::numeric_limits<int>::max();
+    sent_to = std::vector<int>(num_procs, 0);
+    received = 0;
+    timed_out = false;
+
+    // Subtrees of the second level, every process takes every num_procs-th one
+    deques.clear();
+    for (int t = 0; t < num_threads; t++) {
+        deques.push_back(std::make_unique<WorkStealingDeque<Node>>());
+    }
+    Node root = {{}, 0, 0};
+    long long index = 0, pushed = 0;
+    for (int l0 = 0; l0 < n; l0++) {
+        Node child = make_child(root, l0);
+        if (n == 1) {
+            update_incumbent(child.locations, child.cost);
+            continue;
+        }
+        for (int l1 = 0; l1 < n; l1++) {
+            if (l1 != l0 && index++ % num_procs == rank) {
+                Node grandchild = make_child(child, l1);
+                if (n == 2) {
+                    update_incumbent(grandchild.locations, grandchild.cost);  // a complete assignment, nothing to expand
+                    continue;
+                }
+                deques[pushed++ % num_threads]->push(grandchild);
+            }
+        }
+    }
+    pending = pushed;
+
+    MPI_Barrier(comm);
+    double start_time = MPI_Wtime();
+    std::vector<Workspace> workspaces(num_threads);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+    worker(omp_get_thread_num(), workspaces[omp_get_thread_num()], time_limit);
+#else
+    worker(0, workspaces[0], time_limit);
+#endif
+    double local_time = MPI_Wtime() - start_time;
+    finish_exchange();
+
+    // Best solution of all processes
+    struct {
+        int cost;
+        int rank;
+    } local = {own_cost, rank}, best;
+    MPI_Allreduce(&local, &best, 1, MPI_2INT, MPI_MINLOC, comm);
+    std::vector<SolutionCandidate::value_type> values(n);
+    if (rank == best.rank) {
+        std::copy(incumbent.data(), incumbent.data() + n, values.begin());
+    }
+    MPI_Bcast(values.data(), n, SolutionCandidate::mpi_type(), best.rank, comm);
+    SolutionCandidate solution = SolutionCandidate(n);
+    solution.unpack(values.data());
+
+    long long nodes = 0;
+    double busy_time = 0;
+    for (const Workspace &ws : workspaces) {
+        nodes += ws.nodes;
+        busy_time += ws.busy_time;
+    }
+    int finished = !timed_out, all_finished;
+    MPI_Allreduce(&nodes, &stats.nodes, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&local_time, &stats.wall_time, 1, MPI_DOUBLE, MPI_MAX, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &busy_time, 1, MPI_DOUBLE, MPI_SUM, comm);
+    MPI_Allreduce(&finished, &all_finished, 1, MPI_INT, MPI_LAND, comm);
+    stats.workers = num_procs * num_threads;
+    stats.nodes_per_second = stats.wall_time > 0 ? stats.nodes / stats.wall_time : 0;
+    stats.efficiency = stats.wall_time > 0 ? busy_time / (stats.workers * stats.wall_time) : 0;
+    stats.proven = all_finished;
+
+    return std::pair{solution, best.cost};
+}
+
+void QapBranchAndBound::print_stats() const {
+    if (rank != 0) {
+        return;
+    }
+    std::cout << "Nodes: " << stats.nodes << std::endl;
+    std::cout << "Nodes/s: " << stats.nodes_per_second << " (" << stats.nodes_per_second / stats.workers << " per worker, " << stats.workers << " workers)" << std::endl;
+    std::cout << "Efficiency: " << stats.efficiency << std::endl;
+    std::cout << "Optimal: " << (stats.proven ? "proven" : "not proven, time limit reached") << std::endl;
+}
+
+void QapBranchAndBound::worker(int thread, Workspace &ws, double time_limit) {
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    int since_exchange = 0;
+    Node node;
+    while (true) {
+        if (thread == 0 && (++since_exchange >= 64 || pending == 0)) {
+            exchange_incumbent();
+            since_exchange = 0;
+        }
+        if (time_limit != NO_TIME_LIMIT && elapsed() > time_limit) {
+            timed_out = true;
+        }
+        if (timed_out) {
+            break;
+        }
+
+        bool found = deques[thread]->pop(node);
+        for (int t = 1; !found && t < num_threads; t++) {
+            found = deques[(thread + t) % num_threads]->steal(node);
+        }
+        if (!found) {
+            if (pending == 0) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        double busy_start = elapsed();
+        if (node.bound < incumbent_cost) {  // the incumbent may have improved since the node was pushed
+            expand(node, thread, ws);
+            ws.nodes++;
+        }
+        ws.busy_time += elapsed() - busy_start;
+        pending--;
+    }
+}
+
+QapBranchAndBound::Node QapBranchAndBound::make_child(const Node &node, int location) const {
+    int k = node.locations.size();
+    int g = order[k];
+    Node child = {node.locations, node.cost + flowMatrix[g][g] * distanceMatrix[location][location], 0};
+    for (int t = 0; t < k; t++) {
+        int fa = order[t], la = node.locations[t];
+        child.cost += flowMatrix[g][fa] * distanceMatrix[location][la] + flowMatrix[fa][g] * distanceMatrix[la][location];
+    }
+    child.locations.push_back(location);
+    child.bound = child.cost;
+    return child;
+}
+
+void QapBranchAndBound::expand(const Node &node, int thread, Workspace &ws) {
+    int k = node.locations.size();
+    int m = n - k;  // Number of free facilities and locations
+    int g = order[k];
+
+    std::vector<int> &free = ws.free_locations;
+    free.clear();
+    std::vector<char> taken(n, false);
+    for (int l : node.locations) {
+        taken[l] = true;
+    }
+    for (int l = 0; l < n; l++) {
+        if (!taken[l]) free.push_back(l);
+    }
+
+    // Interaction of the free facilities order[k + a] placed on free[b] with the assigned ones
+    ws.interaction.assign(m * m, 0);
+    for (int a = 0; a < m; a++) {
+        int i = order[k + a];
+        for (int b = 0; b < m; b++) {
+            int l = free[b], sum = 0;
+            for (int t = 0; t < k; t++) {
+                int fa = order[t], la = node.locations[t];
+                sum += flowMatrix[i][fa] * distanceMatrix[l][la] + flowMatrix[fa][i] * distanceMatrix[la][l];
+            }
+            ws.interaction[a * m + b] = sum;
+        }
+    }
+
+    // Distances from every free location to the other free ones, descending
+    ws.sorted_distances.resize(m * (m - 1));
+    for (int b = 0; b < m; b++) {
+        int *row = ws.sorted_distances.data() + b * (m - 1);
+        for (int c = 0, e = 0; c < m; c++) {
+            if (c != b) row[e++] = distanceMatrix[free[b]][free[c]];
+        }
+        std::sort(row, row + m - 1, std::greater<int>());
+    }
+
+    ws.children.clear();
+    int size = m - 1;
+    ws.lap_cost.resize(size * size);
+    for (int b0 = 0; b0 < m; b0++) {
+        int l0 = free[b0];
+        int child_cost = node.cost + flowMatrix[g][g] * distanceMatrix[l0][l0] + ws.interaction[b0];
+        if (child_cost >= incumbent_cost) {
+            continue;
+        }
+        if (m == 1) {
+            std::vector<int> locations = node.locations;
+            locations.push_back(l0);
+            update_incumbent(locations, child_cost);
+            continue;
+        }
+
+        // Gilmore-Lawler costs of the remaining facilities on the remaining locations
+        for (int a = 1; a < m; a++) {
+            int i = order[k + a];
+            const std::vector<int> &flows = sorted_flows[k + 1][i];
+            for (int b = 0, col = 0; b < m; b++) {
+                if (b == b0) continue;
+                int l = free[b];
+                // Minimal scalar product, the distance to l0 is no longer free
+                const int *row = ws.sorted_distances.data() + b * (m - 1);
+                int skip = distanceMatrix[l][l0], product = 0;
+                bool skipped = false;
+                for (int e = 0, f = 0; e < m - 1; e++) {
+                    if (!skipped && row[e] == skip) {
+                        skipped = true;
+                        continue;
+                    }
+                    product += flows[f++] * row[e];
+                }
+                ws.lap_cost[(a - 1) * size + col++] = ws.interaction[a * m + b] + flowMatrix[i][g] * distanceMatrix[l][l0] +
+                                                      flowMatrix[g][i] * distanceMatrix[l0][l] + flowMatrix[i][i] * distanceMatrix[l][l] + product;
+            }
+        }
+        long long bound = child_cost + ws.lap.solve(ws.lap_cost, size);
+        if (bound < incumbent_cost) {
+            Node child = {node.locations, child_cost, bound};
+            child.locations.push_back(l0);
+            ws.children.push_back(std::move(child));
+        }
+    }
+
+    // The child with the lowest bound is expanded first
+    std::sort(ws.children.begin(), ws.children.end(), [](const Node &a, const Node &b) { return a.bound > b.bound; });
+    pending += ws.children.size();
+    for (Node &child : ws.children) {
+        deques[thread]->push(std::move(child));
+    }
+}
+
+void QapBranchAndBound::update_incumbent(const std::vector<int> &locations, int cost) {
+    std::lock_guard<std::mutex> lock(incumbent_mutex);
+    if (cost >= own_cost) {
+        return;
+    }
+    std::vector<SolutionCandidate::value_type> values(n);
+    for (int t = 0; t < n; t++) {
+        values[order[t]] = locations[t];
+    }
+    incumbent.unpack(values.data());
+    own_cost = cost;
+    lower_incumbent_cost(cost);
+}
+
+void QapBranchAndBound::lower_incumbent_cost(int cost) {
+    int current = incumbent_cost;
+    while (cost < current && !incumbent_cost.compare_exchange_weak(current, cost)) {
+    }
+}
+
+void QapBranchAndBound::exchange_incumbent() {
+    if (num_procs == 1) {
+        return;
+    }
+    int current = incumbent_cost;
+    if (current < last_sent) {
+        send_values.push_back(current);
+        for (int dest = 0; dest < num_procs; dest++) {
+            if (dest != rank) {
+                MPI_Request request;
+                MPI_Isend(&send_values.back(), 1, MPI_INT, dest, INCUMBENT_TAG, comm, &request);
+                pending_sends.push_back(request);
+                sent_to[dest]++;
+            }
+        }
+        last_sent = current;
+    }
+
+    if (recv_request == MPI_REQUEST_NULL) {
+        MPI_Irecv(&recv_value, 1, MPI_INT, MPI_ANY_SOURCE, INCUMBENT_TAG, comm, &recv_request);
+    }
+    int arrived = 1;
+    while (arrived) {
+        MPI_Test(&recv_request, &arrived, MPI_STATUS_IGNORE);
+        if (arrived) {
+            received++;
+            lower_incumbent_cost(recv_value);
+            MPI_Irecv(&recv_value, 1, MPI_INT, MPI_ANY_SOURCE, INCUMBENT_TAG, comm, &recv_request);
+        }
+    }
+}
+
+void QapBranchAndBound::finish_exchange() {
+    int expected;
+    MPI_Reduce_scatter_block(sent_to.data(), &expected, 1, MPI_INT, MPI_SUM, comm);
+    while (received < expected) {
+        if (recv_request == MPI_REQUEST_NULL) {
+            MPI_Irecv(&recv_value, 1, MPI_INT, MPI_ANY_SOURCE, INCUMBENT_TAG, comm, &recv_request);
+        }
+        MPI_Wait(&recv_request, MPI_STATUS_IGNORE);
+        received++;
+    }
+    if (recv_request != MPI_REQUEST_NULL) {
+        MPI_Cancel(&recv_request);
+        MPI_Request_free(&recv_request);
+    }
+    MPI_Waitall(pending_sends.size(), pending_sends.data(), MPI_STATUSES_IGNORE);
+    pending_sends.clear();
+    send_values.clear();
+}
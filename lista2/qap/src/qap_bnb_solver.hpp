@@ -0,0 +1,153 @@
+#pragma once
+#include <mpi.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "lap_solver.hpp"
+#include "qap_data_reader.hpp"
+#include "qap_eval.hpp"
+#include "work_stealing_deque.hpp"
+
+#define NO_TIME_LIMIT -1
+#define INCUMBENT_TAG 32
+
+/**
+ * Statistics of a branch and bound run, summed over all processes and threads
+ */
+struct BnbStats {
+    long long nodes = 0;          // Number of expanded nodes
+    double wall_time = 0;         // Wall time of the search in seconds
+    double nodes_per_second = 0;  // Expanded nodes per second of wall time
+    double efficiency = 0;        // Time the workers spent expanding nodes over the total time of the workers
+    int workers = 0;              // Number of processes * threads
+    bool proven = false;          // The whole tree was searched, the solution is optimal
+};
+
+/**
+ * Exact branch and bound for the QAP with Gilmore-Lawler lower bounds.
+ * Facilities are assigned in a fixed order (largest total flow first), a node assigns the first k of them.
+ * The bound of a node is the cost of the assigned pairs plus the solution of a linear assignment problem
+ * over the free facilities and locations, where the cost of placing a facility on a location is its
+ * interaction with the assigned facilities plus the minimal scalar product of its flows and the distances of the location.
+ *
+ * The subtrees of the second level are dealt round robin to the processes.
+ * Inside a process the threads search depth first from their own deques and steal from the others when idle.
+ * The first thread of every process sends every improvement of the incumbent cost to the other processes
+ * and polls for theirs, so all processes prune with the best known cost.
+ */
+class QapBranchAndBound {
+   public:
+    /**
+     * @param distanceMatrix distance matrix
+     * @param flowMatrix flow matrix
+     * @param comm communicator of the processes solving the instance
+     */
+    QapBranchAndBound(IntMatrixView distanceMatrix, IntMatrixView flowMatrix, MPI_Comm comm = MPI_COMM_WORLD);
+
+    /**
+     * Set the number of threads of every process, 1 by default.
+     * Only the first thread calls MPI (MPI_THREAD_FUNNELED).
+     */
+    void set_threads(int num_threads);
+
+    /**
+     * Search the tree, collective over the communicator
+     * @param start the initial incumbent, e.g. the result of a heuristic
+     * @param time_limit the time limit in seconds, the best solution found so far is returned when it is reached
+     * @return the best solution of all processes and its cost
+     */
+    std::pair<SolutionCandidate, int> solve(const SolutionCandidate &start, double time_limit = NO_TIME_LIMIT);
+
+    /**
+     * Get the statistics of the last solve
+     */
+    const BnbStats &get_stats() const { return stats; }
+
+    /**
+     * Print the statistics of the last solve on rank 0 of the communicator
+     */
+    void print_stats() const;
+
+   private:
+    /**
+     * Partial assignment, locations[k] is the location of the facility order[k]
+     */
+    struct Node {
+        std::vector<int> locations;
+        int cost;         // Cost of the pairs of assigned facilities
+        long long bound;  // Lower bound of the subtree
+    };
+
+    /**
+     * Buffers of a single thread
+     */
+    struct Workspace {
+        LapSolver lap;
+        std::vector<int> free_locations;
+        std::vector<int> interaction;        // Cost of a free facility on a free location with the assigned facilities
+        std::vector<int> sorted_distances;   // Distances from each free location to the other ones, descending
+        std::vector<int> lap_cost;
+        std::vector<Node> children;
+        long long nodes = 0;
+        double busy_time = 0;
+    };
+
+    IntMatrixView distanceMatrix;
+    IntMatrixView flowMatrix;
+    QapEvaluator evaluator;
+    MPI_Comm comm;
+    int rank;
+    int num_procs;
+    int num_threads = 1;
+    int n;
+
+    std::vector<int> order;                                   // Branching order of the facilities
+    std::vector<std::vector<std::vector<int>>> sorted_flows;  // sorted_flows[k][i] flows from i to the facilities order[k..] but i, ascending
+
+    std::atomic<int> incumbent_cost;  // Best known cost of all processes, used for pruning
+    std::mutex incumbent_mutex;
+    SolutionCandidate incumbent;      // Best solution found by this process
+    int own_cost;                     // Cost of incumbent
+
+    std::vector<std::unique_ptr<WorkStealingDeque<Node>>> deques;
+    std::atomic<long long> pending;  // Nodes pushed and not expanded yet
+    std::atomic<bool> timed_out;
+
+    // Incumbent exchange, only used by the first thread
+    int last_sent;
+    int recv_value;
+    MPI_Request recv_request = MPI_REQUEST_NULL;
+    int received = 0;
+    std::vector<int> sent_to;
+    std::deque<int> send_values;
+    std::vector<MPI_Request> pending_sends;
+
+    BnbStats stats;
+
+    void worker(int thread, Workspace &ws, double time_limit);
+
+    /**
+     * Bound the children of the node and push the promising ones to the deque of the thread
+     */
+    void expand(const Node &node, int thread, Workspace &ws);
+
+    /**
+     * Assign the next facility of the order to the location
+     */
+    Node make_child(const Node &node, int location) const;
+
+    void update_incumbent(const std::vector<int> &locations, int cost);
+
+    void lower_incumbent_cost(int cost);
+
+    void exchange_incumbent();
+
+    /**
+     * Receive the incumbents still in flight, collective
+     */
+    void finish_exchange();
+};
@@ -0,0 +1,53 @@
+#include "qap_eval.hpp"
+
+int QapEvaluator::cost(const SolutionCandidate &candidate) const {
+    return kernel(candidate);
+}
+
+int QapEvaluator::swap_delta(const SolutionCandidate &p, int r, int s) const {
+    const IntMatrixView &f = flowMatrix;
+    const IntMatrixView &d = distanceMatrix;
+    int pr = p[r], ps = p[s];
+    int delta = f[r][r] * (d[ps][ps] - d[pr][pr]) + f[r][s] * (d[ps][pr] - d[pr][ps]) +
+                f[s][r] * (d[pr][ps] - d[ps][pr]) + f[s][s] * (d[pr][pr] - d[ps][ps]);
+    for (int k = 0; k < p.size(); k++) {
+        if (k == r || k == s) continue;
+        int pk = p[k];
+        delta += f[k][r] * (d[pk][ps] - d[pk][pr]) + f[k][s] * (d[pk][pr] - d[pk][ps]) +
+                 f[r][k] * (d[ps][pk] - d[pr][pk]) + f[s][k] * (d[pr][pk] - d[ps][pk]);
+    }
+    return delta;
+}
+
+int QapEvaluator::swap_delta_update(const SolutionCandidate &p, int delta, int r, int s, int u, int v) const {
+    const IntMatrixView &f = flowMatrix;
+    const IntMatrixView &d = distanceMatrix;
+    int pr = p[r], ps = p[s], pu = p[u], pv = p[v];
+    return delta +
+           (f[r][u] - f[r][v] + f[s][v] - f[s][u]) * (d[ps][pu] - d[ps][pv] + d[pr][pv] - d[pr][pu]) +
+           (f[u][r] - f[v][r] + f[v][s] - f[u][s]) * (d[pu][ps] - d[pv][ps] + d[pv][pr] - d[pu][pr]);
+}
+
+void DeltaMatrix::init(const SolutionCandidate &candidate) {
+    int n = candidate.size();
+    delta = IntMatrix(n, std::vector<int>(n, 0));
+    for (int r = 0; r < n; r++) {
+        for (int s = r + 1; s < n; s++) {
+            delta[r][s] = evaluator.swap_delta(candidate, r, s);
+        }
+    }
+}
+
+void DeltaMatrix::apply_swap(SolutionCandidate &candidate, int u, int v) {
+    int n = candidate.size();
+    candidate.swap(u, v);
+    for (int r = 0; r < n; r++) {
+        for (int s = r + 1; s < n; s++) {
+            if (r == u || r == v || s == u || s == v) {
+                delta[r][s] = evaluator.swap_delta(candidate, r, s);
+            } else {
+                delta[r][s] = evaluator.swap_delta_update(candidate, delta[r][s], r, s, u, v);
+            }
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+
+#include "permutation.hpp"
+#include "qap_data_reader.hpp"
+#include "qap_kernels.hpp"
+
+// Assignment of facilities (positions) to locations (values)
+typedef Permutation SolutionCandidate;
+
+/**
+ * Evaluation layer shared by the QAP solvers
+ * cost(p) = sum_i sum_j flow[i][j] * distance[p[i]][p[j]]
+ */
+class QapEvaluator {
+   public:
+    QapEvaluator(IntMatrixView distanceMatrix, IntMatrixView flowMatrix)
+        : distanceMatrix(distanceMatrix), flowMatrix(flowMatrix), kernel(make_qap_cost_kernel(distanceMatrix, flowMatrix)) {}
+
+    /**
+     * Calculate the full cost of the assignment, O(n^2)
+     * Uses the kernel specialized for the size of the instance if there is one
+     */
+    int cost(const SolutionCandidate &candidate) const;
+
+    /**
+     * Calculate the change of the cost caused by swapping the locations of facilities r and s, O(n)
+     */
+    int swap_delta(const SolutionCandidate &candidate, int r, int s) const;
+
+    /**
+     * Update the delta of swapping r and s after the swap of u and v was applied, O(1).
+     * Only valid if {r, s} and {u, v} are disjoint.
+     * @param candidate the assignment after the swap of u and v
+     * @param delta the delta of swapping r and s before the swap of u and v
+     */
+    int swap_delta_update(const SolutionCandidate &candidate, int delta, int r, int s, int u, int v) const;
+
+   private:
+    IntMatrixView distanceMatrix;
+    IntMatrixView flowMatrix;
+    QapCostKernel kernel;
+};
+
+/**
+ * Deltas of all the swap moves of the current assignment.
+ * After a swap only the O(n) rows touching the swapped facilities are recomputed in O(n),
+ * every other delta is updated in O(1).
+ */
+class DeltaMatrix {
+   public:
+    DeltaMatrix(const QapEvaluator &evaluator) : evaluator(evaluator) {}
+
+    /**
+     * Calculate all the deltas from scratch, O(n^3)
+     */
+    void init(const SolutionCandidate &candidate);
+
+    /**
+     * Swap the locations of u and v in the candidate and update the deltas, O(n^2)
+     */
+    void apply_swap(SolutionCandidate &candidate, int u, int v);
+
+    /**
+     * Get the delta of swapping r and s, r < s
+     */
+    int at(int r, int s) const { return delta[r][s]; }
+
+   private:
+    const QapEvaluator &evaluator;
+    IntMatrix delta;
+};
@@ -0,0 +1,87 @@
+#include "qap_ils_solver.hpp"
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <random>
+
+#include "rng.hpp"
+
+QapIlsSolver::QapIlsSolver(IntMatrixView distanceMatrix, IntMatrixView flowMatrix, int min_strength, int max_strength, MPI_Comm comm)
+    : distanceMatrix(distanceMatrix), flowMatrix(flowMatrix), evaluator(this->distanceMatrix, this->flowMatrix), seed(std::random_device()()) {
+    int n = distanceMatrix.size();
+    this->min_strength = std::min(min_strength, n / 2);
+    this->max_strength = std::max(this->min_strength, max_strength > 0 ? max_strength : n / 4);
+
+    MPI_Comm_rank(comm, &rank);
+}
+
+void QapIlsSolver::set_seed(unsigned seed) {
+    this->seed = seed + rank;
+}
+
+int QapIlsSolver::local_search(SolutionCandidate &candidate, DeltaMatrix &delta, int candidateCost) {
+    int n = candidate.size();
+    while (true) {
+        int best_r = -1, best_s = -1, best_delta = 0;
+        for (int r = 0; r < n; r++) {
+            for (int s = r + 1; s < n; s++) {
+                if (delta.at(r, s) < best_delta) {
+                    best_r = r;
+                    best_s = s;
+                    best_delta = delta.at(r, s);
+                }
+            }
+        }
+        if (best_r == -1) {
+            return candidateCost;
+        }
+        delta.apply_swap(candidate, best_r, best_s);
+        candidateCost += best_delta;
+    }
+}
+
+std::pair<SolutionCandidate, int> QapIlsSolver::solve(int max_iter, int num_cities, double time_limit) {
+    SolutionCandidate current = SolutionCandidate(num_cities);
+    std::mt19937 gen = std::mt19937(seed);
+    current.shuffle(gen);
+
+    IntRNG strength = IntRNG(min_strength, max_strength, gen());
+    IntRNG swap = IntRNG(0, num_cities - 1, gen());
+
+    DeltaMatrix delta = DeltaMatrix(evaluator);
+    delta.init(current);
+    int currentCost = local_search(current, delta, evaluator.cost(current));
+    SolutionCandidate bestSolution = current;
+    int bestCost = currentCost;
+
+    double start = MPI_Wtime();
+    for (int iter = 0; iter < max_iter; iter++) {
+        if (time_limit != NO_TIME_LIMIT && MPI_Wtime() - start > time_limit) {
+            break;
+        }
+        SolutionCandidate candidate = current;
+        int candidateCost = currentCost;
+        int k = strength.getNext();
+        for (int i = 0; i < k; i++) {
+            int r = swap.getNext(), s = swap.getNext();
+            if (r == s) continue;
+            candidateCost += delta.at(std::min(r, s), std::max(r, s));
+            delta.apply_swap(candidate, std::min(r, s), std::max(r, s));
+        }
+        candidateCost = local_search(candidate, delta, candidateCost);
+
+        if (candidateCost <= currentCost) {
+            current = candidate;
+            currentCost = candidateCost;
+            if (currentCost < bestCost) {
+                bestCost = currentCost;
+                bestSolution = current;
+            }
+        } else {
+            delta.init(current);  // back to the current local optimum
+        }
+    }
+
+    return std::pair{bestSolution, bestCost};
+}
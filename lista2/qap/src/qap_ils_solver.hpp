@@ -0,0 +1,57 @@
+#pragma once
+#include <mpi.h>
+
+#include <vector>
+
+#include "qap_data_reader.hpp"
+#include "qap_eval.hpp"
+
+#define NO_TIME_LIMIT -1
+
+/**
+ * Iterated Local Search for the QAP.
+ * Each iteration perturbs the current local optimum with a number of random swaps
+ * and descends with best improvement swaps (using the delta matrix) to the next local optimum,
+ * which replaces the current one if it is not worse.
+ * Every process runs an independent search from its own random start.
+ */
+class QapIlsSolver {
+   public:
+    /**
+     * @param distanceMatrix distance matrix
+     * @param flowMatrix flow matrix
+     * @param min_strength minimal number of random swaps of the perturbation
+     * @param max_strength maximal number of random swaps of the perturbation, 0 means n / 4
+     * @param comm communicator of the processes solving the instance
+     */
+    QapIlsSolver(IntMatrixView distanceMatrix, IntMatrixView flowMatrix, int min_strength = 2, int max_strength = 0, MPI_Comm comm = MPI_COMM_WORLD);
+
+    /**
+     * Seed the random generators, every process uses seed + its rank
+     */
+    void set_seed(unsigned seed);
+
+    /**
+     * Solve the problem
+     * @param max_iter the number of perturbations
+     * @param num_cities the size of the instance
+     * @param time_limit the time limit in seconds
+     * @return a pair of the best solution and the cost of the best solution
+     */
+    std::pair<SolutionCandidate, int> solve(int max_iter, int num_cities, double time_limit = NO_TIME_LIMIT);
+
+   private:
+    IntMatrixView distanceMatrix;
+    IntMatrixView flowMatrix;
+    QapEvaluator evaluator;
+    int min_strength;
+    int max_strength;
+    int rank;
+    unsigned seed;
+
+    /**
+     * Apply best improvement swaps until no swap improves the cost
+     * @return the cost of the local optimum
+     */
+    int local_search(SolutionCandidate &candidate, DeltaMatrix &delta, int candidateCost);
+};
@@ -0,0 +1,219 @@
+#include "qap_runner.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+#include "qap_bnb_solver.hpp"
+#include "qap_data_reader.hpp"
+#include "qap_ils_solver.hpp"
+#include "qap_solver.hpp"
+#include "qap_tabu_solver.hpp"
+#include "solver_config.hpp"
+
+std::pair<SolutionCandidate, int> run_qap_solver(const QapRunConfig &config, IntMatrixView distanceMatrix, IntMatrixView flowMatrix, MPI_Comm comm) {
+    int n = distanceMatrix.size();
+    if (config.solver == "rts") {
+        QapTabuSolver solver = QapTabuSolver(distanceMatrix, flowMatrix, 0, 0, 0, comm);
+        if (config.seeded) solver.set_seed(config.seed);
+        return solver.solve(config.max_iter > 0 ? config.max_iter : 10000, n, config.time_limit);
+    } else if (config.solver == "ils") {
+        QapIlsSolver solver = QapIlsSolver(distanceMatrix, flowMatrix, 2, 0, comm);
+        if (config.seeded) solver.set_seed(config.seed);
+        return solver.solve(config.max_iter > 0 ? config.max_iter : 2000, n, config.time_limit);
+    } else if (config.solver == "sa") {
+        QapSolver solver = QapSolver(distanceMatrix, flowMatrix, 0.997, comm);
+        if (config.seeded) solver.set_seed(config.seed);
+        return solver.solve(config.max_iter > 0 ? config.max_iter : 1000, n, 100, 100);
+    } else if (config.solver == "bnb") {
+        // A short tabu search gives the initial incumbent, so the tree is pruned from the start
+        QapTabuSolver heuristic = QapTabuSolver(distanceMatrix, flowMatrix, 0, 0, 0, comm);
+        if (config.seeded) heuristic.set_seed(config.seed);
+        auto start = heuristic.solve(config.max_iter > 0 ? config.max_iter : 2000, n, config.time_limit);
+        QapBranchAndBound solver = QapBranchAndBound(distanceMatrix, flowMatrix, comm);
+#ifdef _OPENMP
+        solver.set_threads(omp_get_max_threads());
+#endif
+        auto solution = solver.solve(start.first, config.time_limit);
+        solver.print_stats();
+        return solution;
+    }
+    throw std::runtime_error("Unknown solver " + config.solver);
+}
+
+std::vector<QapJob> read_manifest(const std::string &filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file");
+    }
+    std::vector<QapJob> jobs;
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); line_number++) {
+        std::istringstream fields(line);
+        QapJob job;
+        if (!(fields >> job.config.solver) || job.config.solver[0] == '#') {
+            continue;
+        }
+        if (!(fields >> job.n >> job.instance >> job.config.seed)) {
+            throw std::runtime_error("Invalid job on line " + std::to_string(line_number) + " of " + filename);
+        }
+        // The matrices of a job are allocated with the size of the manifest, it must match the instance
+        int instance_n = read_dimensions(job.instance, 1)[0];
+        if (instance_n != job.n) {
+            throw std::runtime_error("The job on line " + std::to_string(line_number) + " of " + filename + " has n = " + std::to_string(job.n) +
+                                     ", but " + job.instance + " has n = " + std::to_string(instance_n));
+        }
+        job.config.seeded = true;
+        std::string param;
+        while (fields >> param) {
+            if (param.rfind("iter=", 0) == 0) {
+                job.config.max_iter = std::stoi(param.substr(5));
+            } else if (param.rfind("time=", 0) == 0) {
+                job.config.time_limit = std::stod(param.substr(5));
+            } else {
+                throw std::runtime_error("Invalid parameter " + param + " on line " + std::to_string(line_number) + " of " + filename);
+            }
+        }
+        job.id = jobs.size();
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+QapJobRunner::QapJobRunner(const std::vector<QapJob> &jobs, int ranks_per_job) : jobs(jobs), ranks_per_job(std::max(1, ranks_per_job)) {
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+}
+
+void QapJobRunner::run(const std::string &results_file) {
+    std::ofstream out;
+    if (rank == 0) {
+        out.open(results_file);
+        if (!out.is_open()) {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        out << "job,solver,n,instance,seed,cost,wall_time,cpu_time,solution" << std::endl;
+    }
+
+    if (num_procs == 1) {
+        for (const QapJob &job : jobs) {
+            out << run_job(job, MPI_COMM_SELF) << std::endl;
+        }
+        return;
+    }
+
+    // Workers 1..num_procs-1 are grouped by consecutive ranks, the master takes no group
+    MPI_Comm group;
+    MPI_Comm_split(MPI_COMM_WORLD, rank == 0 ? MPI_UNDEFINED : (rank - 1) / ranks_per_job, rank, &group);
+    if (rank == 0) {
+        master(out, (num_procs - 2) / ranks_per_job + 1);
+    } else {
+        worker(group);
+        MPI_Comm_free(&group);
+    }
+}
+
+void QapJobRunner::master(std::ofstream &out, int num_groups) {
+    size_t next_job = 0;
+    int finished_groups = 0;
+    while (finished_groups < num_groups) {
+        // A request carries the result of the previous job of the group, empty for the first request
+        MPI_Status status;
+        MPI_Probe(MPI_ANY_SOURCE, JOB_REQUEST_TAG, MPI_COMM_WORLD, &status);
+        int length;
+        MPI_Get_count(&status, MPI_CHAR, &length);
+        std::string result(length, '\0');
+        MPI_Recv(result.data(), length, MPI_CHAR, status.MPI_SOURCE, JOB_REQUEST_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (length > 0) {
+            out << result << std::endl;
+        }
+
+        int job = -1;  // -1 tells the group to stop
+        if (next_job < jobs.size()) {
+            job = next_job++;
+        } else {
+            finished_groups++;
+        }
+        MPI_Send(&job, 1, MPI_INT, status.MPI_SOURCE, JOB_TAG, MPI_COMM_WORLD);
+    }
+    std::cout << "Completed " << jobs.size() << " jobs" << std::endl;
+}
+
+void QapJobRunner::worker(MPI_Comm group) {
+    int group_rank;
+    MPI_Comm_rank(group, &group_rank);
+    std::string result;
+    while (true) {
+        int job;
+        if (group_rank == 0) {
+            MPI_Send(result.data(), result.size(), MPI_CHAR, 0, JOB_REQUEST_TAG, MPI_COMM_WORLD);
+            MPI_Recv(&job, 1, MPI_INT, 0, JOB_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+        MPI_Bcast(&job, 1, MPI_INT, 0, group);
+        if (job < 0) {
+            break;
+        }
+        result = run_job(jobs[job], group);
+    }
+}
+
+std::string QapJobRunner::run_job(const QapJob &job, MPI_Comm group) {
+    int group_rank;
+    MPI_Comm_rank(group, &group_rank);
+
+    // The instance is shared by the processes of the group on the same node
+    SharedMatrix<int> flowMatrix(job.n, job.n, group);
+    SharedMatrix<int> distanceMatrix(job.n, job.n, group);
+    {
+        IntMatrix f, d;
+        if (group_rank == 0) {
+            QapDataReader reader = QapDataReader();
+            std::string filename = job.instance;
+            std::tie(std::ignore, f, d) = reader.fromDataFile(filename);
+        }
+        flowMatrix.distribute(f);
+        distanceMatrix.distribute(d);
+    }
+
+    double wall_start = MPI_Wtime();
+    std::clock_t cpu_start = std::clock();
+    auto solution = run_qap_solver(job.config, distanceMatrix.view(), flowMatrix.view(), group);
+    double cpu_time = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    // Best solution of the group
+    struct {
+        int cost;
+        int rank;
+    } local = {solution.second, group_rank}, best;
+    MPI_Allreduce(&local, &best, 1, MPI_2INT, MPI_MINLOC, group);
+    double total_cpu_time;
+    MPI_Reduce(&cpu_time, &total_cpu_time, 1, MPI_DOUBLE, MPI_SUM, 0, group);
+    std::vector<SolutionCandidate::value_type> best_solution(job.n);
+    if (group_rank == best.rank) {
+        std::copy(solution.first.data(), solution.first.data() + job.n, best_solution.begin());
+    }
+    MPI_Bcast(best_solution.data(), job.n, SolutionCandidate::mpi_type(), best.rank, group);
+    double wall_time = MPI_Wtime() - wall_start;
+
+    flowMatrix.release();
+    distanceMatrix.release();
+    if (group_rank != 0) {
+        return "";
+    }
+
+    std::ostringstream line;
+    line << job.id << "," << job.config.solver << "," << job.n << "," << job.instance << "," << job.config.seed << ","
+         << best.cost << "," << wall_time << "," << total_cpu_time << ",";
+    for (int i = 0; i < job.n; i++) {
+        line << (i > 0 ? " " : "") << best_solution[i] + 1;
+    }
+    return line.str();
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <mpi.h>
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "qap_eval.hpp"
+#include "shared_matrix.hpp"
+
+#define JOB_REQUEST_TAG 30
+#define JOB_TAG 31
+
+/**
+ * Parameters of a single solver run
+ */
+struct QapRunConfig {
+    std::string solver = "sa";  // sa, rts, ils or bnb (exact, starts from rts)
+    int max_iter = 0;           // 0 means the default of the solver
+    double time_limit = 10.0;   // Time limit in seconds of rts, ils and bnb
+    bool seeded = false;        // Use seed instead of a random seed
+    unsigned seed = 0;
+};
+
+/**
+ * Run a solver on an instance, collective over the communicator
+ * @param config the solver and its parameters
+ * @param distanceMatrix distance matrix
+ * @param flowMatrix flow matrix
+ * @param comm the processes solving the instance
+ * @return the best solution and its cost found by this process
+ */
+std::pair<SolutionCandidate, int> run_qap_solver(const QapRunConfig &config, IntMatrixView distanceMatrix, IntMatrixView flowMatrix, MPI_Comm comm);
+
+/**
+ * A single run of the manifest
+ */
+struct QapJob {
+    int id;                // Index of the job in the manifest
+    int n;                 // Size of the instance
+    std::string instance;  // Path of the instance file
+    QapRunConfig config;
+};
+
+/**
+ * Read a job manifest, one job per line:
+ * <solver> <n> <instance> <seed> [iter=<max_iter>] [time=<seconds>]
+ * Empty lines and lines starting with # are skipped, a job whose n differs from the size of its instance is rejected.
+ * @param filename the manifest file
+ */
+std::vector<QapJob> read_manifest(const std::string &filename);
+
+/**
+ * Runs all the jobs of a manifest in one MPI allocation.
+ * Rank 0 is the master, it hands out the jobs and writes the results file.
+ * The other ranks are split into groups of ranks_per_job processes, a group solves one job at a time
+ * on its own communicator and its first process asks the master for the next job as soon as the previous one is done,
+ * so groups that get short jobs take more of them.
+ * With a single process, rank 0 runs all the jobs itself.
+ */
+class QapJobRunner {
+   public:
+    /**
+     * @param jobs the jobs of the manifest
+     * @param ranks_per_job number of processes solving a single job
+     */
+    QapJobRunner(const std::vector<QapJob> &jobs, int ranks_per_job);
+
+    /**
+     * Run all the jobs, collective over MPI_COMM_WORLD.
+     * Every result is appended to the results file as soon as it arrives, in the order the jobs finish.
+     * @param results_file the results file (csv), written by rank 0
+     */
+    void run(const std::string &results_file);
+
+   private:
+    std::vector<QapJob> jobs;
+    int ranks_per_job;
+    int rank;
+    int num_procs;
+
+    void master(std::ofstream &out, int num_groups);
+    void worker(MPI_Comm group);
+
+    /**
+     * Solve a job, collective over the group
+     * @return the result line on the first process of the group, empty on the others
+     */
+    std::string run_job(const QapJob &job, MPI_Comm group);
+};
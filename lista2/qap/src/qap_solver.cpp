@@ -2,36 +2,33 @@
 
 #include <mpi.h>
 
+#include <random>
+
 #include "rng.hpp"
 
-QapSolver::QapSolver(const IntMatrix &distanceMatrix, const IntMatrix &flowMatrix, double coolingRate) {
-    this->distanceMatrix = distanceMatrix;
-    this->flowMatrix = flowMatrix;
+QapSolver::QapSolver(IntMatrixView distanceMatrix, IntMatrixView flowMatrix, double coolingRate, MPI_Comm comm)
+    : distanceMatrix(distanceMatrix), flowMatrix(flowMatrix), evaluator(this->distanceMatrix, this->flowMatrix), comm(comm), seed(std::random_device()()) {
     this->coolingRate = coolingRate;
 
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+}
+
+void QapSolver::set_seed(unsigned seed) {
+    this->seed = seed + rank;
 }
 
 int QapSolver::cost(SolutionCandidate const &candidate) {
-    int cost = 0;
-    for (int i = 0; i < candidate.size(); i++) {
-        for (int j = 0; j < candidate.size(); j++) {
-            cost += flowMatrix[i][j] * distanceMatrix[candidate[i] - 1][candidate[j] - 1];
-        }
-    }
-    return cost;
+    return evaluator.cost(candidate);
 }
 
 std::pair<SolutionCandidate, int> QapSolver::solve(int max_iter, int num_cities, int exchange_period, double init_temp) {
     SolutionCandidate bestSolution = SolutionCandidate(num_cities);
-    for (int i = 0; i < num_cities; i++) {
-        bestSolution[i] = i + 1;
-    }
 
-    IntRNG swap = IntRNG(0, num_cities - 1);
-    IntRNG with = IntRNG(0, num_cities - 1);
-    DoubleRNG prob = DoubleRNG(0, 1);
+    std::mt19937 gen = std::mt19937(seed);
+    IntRNG swap = IntRNG(0, num_cities - 1, gen());
+    IntRNG with = IntRNG(0, num_cities - 1, gen());
+    DoubleRNG prob = DoubleRNG(0, 1, gen());
 
     double temp = init_temp;
     int bestCost = cost(bestSolution);
@@ -39,7 +36,7 @@ std::pair<SolutionCandidate, int> QapSolver::solve(int max_iter, int num_cities,
     for (int i = 0; i < max_iter; i++) {
         int swapIndex = swap.getNext();
         int withIndex = with.getNext();
-        std::swap(bestSolution[swapIndex], bestSolution[withIndex]);
+        bestSolution.swap(swapIndex, withIndex);
         int currentCost = cost(bestSolution);
 
         int delta = currentCost - bestCost;
@@ -48,15 +45,16 @@ std::pair<SolutionCandidate, int> QapSolver::solve(int max_iter, int num_cities,
         } else if (prob.getNext() < exp(-delta / temp)) {
             bestCost = currentCost;
         } else {
-            std::swap(bestSolution[swapIndex], bestSolution[withIndex]);
+            bestSolution.undo();
         }
 
         if (i % exchange_period == 0) {
-            std::vector<int> globalSolutions = std::vector<int>(num_procs * num_cities);
-            MPI_Allgather(bestSolution.data(), num_cities, MPI_INT, globalSolutions.data(), num_cities, MPI_INT, MPI_COMM_WORLD);
+            std::vector<SolutionCandidate::value_type> globalSolutions(num_procs * num_cities);
+            MPI_Allgather(bestSolution.data(), num_cities, SolutionCandidate::mpi_type(), globalSolutions.data(), num_cities, SolutionCandidate::mpi_type(), comm);
 
             for (int j = 0; j < num_procs; j++) {
-                SolutionCandidate candidate = SolutionCandidate(globalSolutions.begin() + j * num_cities, globalSolutions.begin() + (j + 1) * num_cities);
+                SolutionCandidate candidate = SolutionCandidate(num_cities);
+                candidate.unpack(globalSolutions.data() + j * num_cities);
                 int candidateCost = cost(candidate);
 
                 if (candidateCost < bestCost) {
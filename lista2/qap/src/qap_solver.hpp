@@ -1,22 +1,31 @@
 #pragma once
+#include <mpi.h>
+
 #include <vector>
 
 #include "qap_data_reader.hpp"
-
-typedef std::vector<int> SolutionCandidate;
+#include "qap_eval.hpp"
 
 class QapSolver {
    public:
     double coolingRate;
-    QapSolver(const IntMatrix &distanceMatrix, const IntMatrix &flowMatrix, double coolingRate);
+    QapSolver(IntMatrixView distanceMatrix, IntMatrixView flowMatrix, double coolingRate, MPI_Comm comm = MPI_COMM_WORLD);
+
+    /**
+     * Seed the random generators, every process uses seed + its rank
+     */
+    void set_seed(unsigned seed);
 
     std::pair<SolutionCandidate, int> solve(int max_iter, int num_cities, int exchange_period, double init_temp);
 
    private:
-    IntMatrix distanceMatrix;
-    IntMatrix flowMatrix;
+    IntMatrixView distanceMatrix;
+    IntMatrixView flowMatrix;
+    QapEvaluator evaluator;
+    MPI_Comm comm;
     int rank;
     int num_procs;
+    unsigned seed;
 
     int cost(const SolutionCandidate &candidate);
 };
@@ -0,0 +1,89 @@
+#include "qap_tabu_solver.hpp"
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+
+#include "rng.hpp"
+
+QapTabuSolver::QapTabuSolver(IntMatrixView distanceMatrix, IntMatrixView flowMatrix, int min_tenure, int max_tenure, int aspiration, MPI_Comm comm)
+    : distanceMatrix(distanceMatrix), flowMatrix(flowMatrix), evaluator(this->distanceMatrix, this->flowMatrix), seed(std::random_device()()) {
+    int n = distanceMatrix.size();
+    this->min_tenure = min_tenure > 0 ? min_tenure : std::max(1, (int)(0.9 * n));
+    this->max_tenure = max_tenure > 0 ? max_tenure : std::max(this->min_tenure, (int)(1.1 * n));
+    this->aspiration = aspiration > 0 ? aspiration : n * n * 5;
+
+    MPI_Comm_rank(comm, &rank);
+}
+
+void QapTabuSolver::set_seed(unsigned seed) {
+    this->seed = seed + rank;
+}
+
+std::pair<SolutionCandidate, int> QapTabuSolver::solve(int max_iter, int num_cities, double time_limit) {
+    SolutionCandidate current = SolutionCandidate(num_cities);
+    std::mt19937 gen = std::mt19937(seed);
+    current.shuffle(gen);
+
+    IntRNG tenure = IntRNG(min_tenure, max_tenure, gen());
+
+    // tabu[i][l] iteration at which facility i was last moved away from location l
+    IntMatrix tabu = IntMatrix(num_cities, std::vector<int>(num_cities, -(num_cities * num_cities)));
+
+    DeltaMatrix delta = DeltaMatrix(evaluator);
+    delta.init(current);
+    int currentCost = evaluator.cost(current);
+    SolutionCandidate bestSolution = current;
+    int bestCost = currentCost;
+    int current_tenure = tenure.getNext();
+
+    double start = MPI_Wtime();
+    for (int iter = 1; iter <= max_iter; iter++) {
+        if (time_limit != NO_TIME_LIMIT && MPI_Wtime() - start > time_limit) {
+            break;
+        }
+        // Change the tenure from time to time, as in the original robust tabu search
+        if (iter % (2 * max_tenure) == 0) {
+            current_tenure = tenure.getNext();
+        }
+
+        int best_r = -1, best_s = -1;
+        int best_delta = std::numeric_limits<int>::max();
+        bool already_aspired = false;
+        for (int r = 0; r < num_cities; r++) {
+            for (int s = r + 1; s < num_cities; s++) {
+                int d = delta.at(r, s);
+                int r_left = tabu[r][current[s]], s_left = tabu[s][current[r]];
+                // tabu only if both facilities return to recently left locations, unless it gives a new best
+                bool authorized = r_left + current_tenure < iter || s_left + current_tenure < iter || currentCost + d < bestCost;
+                // a facility not placed on the location for a long time forces the move
+                bool aspired = r_left + aspiration < iter || s_left + aspiration < iter;
+
+                if ((aspired && !already_aspired) || (aspired && already_aspired && d < best_delta) ||
+                    (!aspired && !already_aspired && authorized && d < best_delta)) {
+                    best_r = r;
+                    best_s = s;
+                    best_delta = d;
+                    already_aspired |= aspired;
+                }
+            }
+        }
+        if (best_r == -1) {
+            continue;  // every move is tabu
+        }
+
+        tabu[best_r][current[best_r]] = iter;
+        tabu[best_s][current[best_s]] = iter;
+        delta.apply_swap(current, best_r, best_s);
+        currentCost += best_delta;
+
+        if (currentCost < bestCost) {
+            bestCost = currentCost;
+            bestSolution = current;
+        }
+    }
+
+    return std::pair{bestSolution, bestCost};
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <mpi.h>
+
+#include <vector>
+
+#include "qap_data_reader.hpp"
+#include "qap_eval.hpp"
+
+#define NO_TIME_LIMIT -1
+
+/**
+ * Robust Tabu Search (Taillard) for the QAP.
+ * Each iteration scans the whole swap neighbourhood using the delta matrix,
+ * a move is tabu if it places both facilities on locations they occupied recently,
+ * unless it leads to a new best solution (aspiration).
+ * Every process runs an independent search from its own random start.
+ */
+class QapTabuSolver {
+   public:
+    /**
+     * @param distanceMatrix distance matrix
+     * @param flowMatrix flow matrix
+     * @param min_tenure minimal tabu tenure, 0 means 0.9 * n
+     * @param max_tenure maximal tabu tenure, 0 means 1.1 * n
+     * @param aspiration a move placing a facility on a location it did not occupy for this many iterations is always allowed, 0 means n^2 * 5
+     * @param comm communicator of the processes solving the instance
+     */
+    QapTabuSolver(IntMatrixView distanceMatrix, IntMatrixView flowMatrix, int min_tenure = 0, int max_tenure = 0, int aspiration = 0, MPI_Comm comm = MPI_COMM_WORLD);
+
+    /**
+     * Seed the random generators, every process uses seed + its rank
+     */
+    void set_seed(unsigned seed);
+
+    /**
+     * Solve the problem
+     * @param max_iter the number of iterations
+     * @param num_cities the size of the instance
+     * @param time_limit the time limit in seconds
+     * @return a pair of the best solution and the cost of the best solution
+     */
+    std::pair<SolutionCandidate, int> solve(int max_iter, int num_cities, double time_limit = NO_TIME_LIMIT);
+
+   private:
+    IntMatrixView distanceMatrix;
+    IntMatrixView flowMatrix;
+    QapEvaluator evaluator;
+    int min_tenure;
+    int max_tenure;
+    int aspiration;
+    int rank;
+    unsigned seed;
+};
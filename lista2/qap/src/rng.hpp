@@ -8,6 +8,11 @@ class IntRNG {
         dist = std::uniform_int_distribution<int>(min, max);
     }
 
+    IntRNG(int min, int max, unsigned seed) {
+        gen = std::mt19937(seed);
+        dist = std::uniform_int_distribution<int>(min, max);
+    }
+
     int getNext() {
         return dist(gen);
     }
@@ -25,6 +30,11 @@ class DoubleRNG {
         dist = std::uniform_real_distribution<double>(min, max);
     }
 
+    DoubleRNG(double min, double max, unsigned seed) {
+        gen = std::mt19937(seed);
+        dist = std::uniform_real_distribution<double>(min, max);
+    }
+
     double getNext() {
         return dist(gen);
     }
@@ -0,0 +1,50 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/**
+ * Deque of tasks of a single worker thread.
+ * The owner pushes and pops at the back (depth first), idle threads steal from the front,
+ * where the oldest and usually largest subtrees are.
+ */
+template <typename T>
+class WorkStealingDeque {
+   public:
+    void push(T task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+
+    /**
+     * Take the newest task, called by the owner
+     * @return false if the deque is empty
+     */
+    bool pop(T &task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) {
+            return false;
+        }
+        task = std::move(tasks.back());
+        tasks.pop_back();
+        return true;
+    }
+
+    /**
+     * Take the oldest task, called by the other threads
+     * @return false if the deque is empty
+     */
+    bool steal(T &task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) {
+            return false;
+        }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+        return true;
+    }
+
+   private:
+    std::mutex mutex;
+    std::deque<T> tasks;
+};
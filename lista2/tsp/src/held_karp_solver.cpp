@@ -0,0 +1,141 @@
+#include "held_karp_solver.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+HeldKarpSolver::HeldKarpSolver(MatrixView<double> adj_mat, MPI_Comm comm) : adj_mat(adj_mat), comm(comm), n(adj_mat.size()), m(adj_mat.size() - 1) {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+}
+
+void HeldKarpSolver::set_threads(int num_threads) {
+    this->num_threads = std::max(1, num_threads);
+}
+
+std::pair<double, Path> HeldKarpSolver::solve() {
+    if (n > MAX_EXACT_CITIES) {
+        throw std::runtime_error("The exact solver supports up to " + std::to_string(MAX_EXACT_CITIES) + " cities");
+    }
+    if (n < 3) {
+        Path path = {0};
+        for (int i = 1; i < n; i++) path.push_back(i);
+        path.push_back(0);
+        double length = 0.0;
+        for (size_t i = 1; i < path.size(); i++) length += adj_mat[path[i - 1]][path[i]];
+        return {length, path};
+    }
+
+    dist.resize((size_t)m * m);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < m; j++) {
+            dist[(size_t)i * m + j] = adj_mat[i + 1][j + 1];
+        }
+    }
+    order_subsets();
+    dp.assign(order.size() * m, std::numeric_limits<float>::infinity());
+
+    std::vector<int> counts(num_procs), displs(num_procs);
+    for (int layer = 1; layer <= m; layer++) {
+        size_t begin = layer_begin[layer], size = layer_begin[layer + 1] - begin;
+        for (int p = 0; p < num_procs; p++) {
+            displs[p] = (begin + size * p / num_procs) * m;
+            counts[p] = (begin + size * (p + 1) / num_procs) * m - displs[p];
+        }
+        compute_rows(displs[rank] / m, (displs[rank] + counts[rank]) / m, layer);
+        if (num_procs > 1) {
+            MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, dp.data(), counts.data(), displs.data(), MPI_FLOAT, comm);
+        }
+    }
+
+    Path path = backtrack();
+    double length = 0.0;
+    for (size_t i = 1; i < path.size(); i++) {
+        length += adj_mat[path[i - 1]][path[i]];
+    }
+    return {length, path};
+}
+
+void HeldKarpSolver::order_subsets() {
+    size_t subsets = (size_t)1 << m;
+    layer_begin.assign(m + 2, 0);
+    for (size_t s = 0; s < subsets; s++) {
+        layer_begin[__builtin_popcount(s) + 1]++;
+    }
+    for (int k = 1; k <= m + 1; k++) {
+        layer_begin[k] += layer_begin[k - 1];
+    }
+    order.resize(subsets);
+    index.resize(subsets);
+    std::vector<size_t> next(layer_begin.begin(), layer_begin.end() - 1);
+    for (size_t s = 0; s < subsets; s++) {
+        size_t position = next[__builtin_popcount(s)]++;
+        order[position] = s;
+        index[s] = position;
+    }
+}
+
+void HeldKarpSolver::compute_rows(size_t first, size_t last, int layer) {
+#pragma omp parallel for schedule(dynamic, 64) num_threads(num_threads) if (num_threads > 1)
+    for (size_t position = first; position < last; position++) {
+        unsigned subset = order[position];
+        float *row = dp.data() + position * m;
+        for (unsigned bits = subset; bits; bits &= bits - 1) {
+            int j = __builtin_ctz(bits);
+            if (layer == 1) {
+                row[j] = adj_mat[0][j + 1];
+                continue;
+            }
+            // The last step comes from the best end i of the path through the subset without j
+            unsigned rest = subset & ~(1u << j);
+            const float *previous = dp.data() + (size_t)index[rest] * m;
+            float best = std::numeric_limits<float>::infinity();
+            for (unsigned other = rest; other; other &= other - 1) {
+                int i = __builtin_ctz(other);
+                best = std::min(best, previous[i] + dist[(size_t)i * m + j]);
+            }
+            row[j] = best;
+        }
+    }
+}
+
+Path HeldKarpSolver::backtrack() const {
+    unsigned subset = ((size_t)1 << m) - 1;
+    // The last city before returning to 0
+    int last = -1;
+    float best = std::numeric_limits<float>::infinity();
+    const float *row = dp.data() + (size_t)index[subset] * m;
+    for (int j = 0; j < m; j++) {
+        float length = row[j] + (float)adj_mat[j + 1][0];
+        if (length < best) {
+            best = length;
+            last = j;
+        }
+    }
+
+    Path reversed = {0};
+    while (subset) {
+        reversed.push_back(last + 1);
+        unsigned rest = subset & ~(1u << last);
+        int previous_city = -1;
+        best = std::numeric_limits<float>::infinity();
+        const float *previous = dp.data() + (size_t)index[rest] * m;
+        for (unsigned other = rest; other; other &= other - 1) {
+            int i = __builtin_ctz(other);
+            float length = previous[i] + dist[(size_t)i * m + last];
+            if (length < best) {
+                best = length;
+                previous_city = i;
+            }
+        }
+        subset = rest;
+        last = previous_city;
+    }
+    reversed.push_back(0);
+    return Path(reversed.rbegin(), reversed.rend());
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <mpi.h>
+
+#include <utility>
+#include <vector>
+
+#include "mpi_pacs.hpp"
+#include "shared_matrix.hpp"
+
+#define MAX_EXACT_CITIES 25
+
+/**
+ * Exact TSP solver, Held-Karp dynamic programming over the subsets of the cities.
+ * dp[S][j] is the length of the shortest path from city 0 through all cities of S ending in j (j in S, 0 not in S).
+ * The subsets are stored by popcount layers, S of layer k only depends on the subsets of layer k - 1,
+ * so every layer is one contiguous block computed in parallel: the block is split between the processes,
+ * every process splits its part between its threads and the parts are gathered by all processes.
+ * The lengths are stored as floats, which keeps 25 cities in 1.6 GB per process, the optimal tour is
+ * recovered from the table and its length recomputed in double precision.
+ * Time O(2^n n^2), memory O(2^n n), up to MAX_EXACT_CITIES cities.
+ */
+class HeldKarpSolver {
+   public:
+    /**
+     * @param adj_mat adjacency matrix, may be asymmetric
+     * @param comm communicator of the processes solving the instance
+     */
+    HeldKarpSolver(MatrixView<double> adj_mat, MPI_Comm comm = MPI_COMM_WORLD);
+
+    /**
+     * Set the number of threads of every process, 1 by default
+     */
+    void set_threads(int num_threads);
+
+    /**
+     * Solve the instance, collective over the communicator
+     * @return the length of the optimal tour and the tour, starting and ending in city 0
+     */
+    std::pair<double, Path> solve();
+
+   private:
+    MatrixView<double> adj_mat;
+    MPI_Comm comm;
+    int rank;
+    int num_procs;
+    int num_threads = 1;
+    int n;
+    int m;  // Number of cities but city 0, the bits of the subsets
+
+    std::vector<float> dist;          // dist[i * m + j] from city i + 1 to city j + 1
+    std::vector<unsigned> order;      // Subsets sorted by popcount
+    std::vector<unsigned> index;      // index[S] is the position of S in order and the row of S in dp
+    std::vector<size_t> layer_begin;  // Position of the first subset of every popcount
+    std::vector<float> dp;            // Row of every subset, m entries
+
+    void order_subsets();
+
+    /**
+     * Compute the rows of the subsets order[first..last)
+     */
+    void compute_rows(size_t first, size_t last, int layer);
+
+    /**
+     * Recover the optimal tour from the table
+     */
+    Path backtrack() const;
+};
@@ -1,64 +1,184 @@
 #include <mpi.h>
 #include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <algorithm>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <random>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include "../include/pugixml.hpp"
+#include "held_karp_solver.hpp"
 #include "mpi_pacs.hpp"
+#include "one_tree_bound.hpp"
+#include "partitioned_pacs.hpp"
+#include "racing_tuner.hpp"
+#include "solver_config.hpp"
 
 // IO functions
 
 void print_table(const Matrix &table, bool like_float = false);
 void parse_xml(const char *filename, Matrix &vertecies);
-void parse_args(int argc, char **argv, int &n, char *&filename);
-void print_path(const Path &path, int cost);
+int count_vertices(const char *filename);
+void print_path(const Path &path, int cost, double bound = 0);
+void tune(SolverConfig &config, int rank);
+void parse_tsplib(const char *filename, std::vector<Point> &cities, DistanceRounding &rounding);
+void partition(SolverConfig &config, const std::string &filename, int rank);
+template <typename Pheromone>
+std::pair<double, Path> run_colony(SolverConfig &config, MatrixView<double> adj_mat, const Matrix &pheromones, double bound, int rank);
 
 int main(int argc, char **argv) {
     int n;
     int rank;
-    char *filename;
 
     MPI_Init(&argc, &argv);                // Initialize the MPI environment
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);  // Get the rank of the process
-    parse_args(argc, argv, n, filename);   // Parse cmd line arguments
 
-    Matrix adj_mat = Matrix(n, std::vector<double>(n, 0.0));
+    // Parameters from the command line and the optional config file, <n> <filename> [sync|async] is still accepted
+    SolverConfig config = SolverConfig(argc, argv, {"exact", "partition", "print-config"});
+    if (config.has("tune-instances")) {
+        tune(config, rank);
+        MPI_Finalize();
+        return 0;
+    }
+    std::string filename = config.get_string("instance", config.positional(1, ""));
+    if (filename.empty()) {
+        if (rank == 0) {
+            std::cerr << "Usage: " << argv[0] << " --instance <filename> [--config <file>] [--sync sync|async] [--ants 10] [--iterations 1000]" << std::endl;
+            std::cerr << "       [--comm-freq 80] [--time-limit 10] [--beta -3] [--rho 0.3] [--theta 2] [--q 100] [--tau 0.6] [--seed <seed>]" << std::endl;
+            std::cerr << "       [--pheromone-precision double|float|fixed16] [--pheromone-rounding nearest|stochastic]" << std::endl;
+            std::cerr << "       [--bound-iterations 1000] [--gap 0] [--exact [--threads <n>]] [--partition [--repair-rounds 2]] [--print-config]" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (config.get_bool("partition", false)) {
+        partition(config, filename, rank);
+        MPI_Finalize();
+        return 0;
+    }
+    if (rank == 0) {
+        n = count_vertices(filename.c_str());  // The number of cities is read from the instance
+    }
+    MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    SharedMatrix<double> adj_mat = SharedMatrix<double>(n, n);  // Stored once per node and shared by all its processes
     Matrix pheromones = Matrix(n, std::vector<double>(n, 1.0));  // Initialize the pheromones table
 
     // Initialize the necessary data
+    Matrix vertecies;
     if (rank == 0) {
-        parse_xml(filename, adj_mat);  // Parse the xml file and print the adjacency matrix for verification
+        vertecies = Matrix(n, std::vector<double>(n, 0.0));
+        parse_xml(filename.c_str(), vertecies);  // Parse the xml file and print the adjacency matrix for verification
+    }
+
+    adj_mat.distribute(vertecies);  // Copy the adjacency matrix to the shared memory of every node
+
+    if (config.get_bool("exact", false)) {
+        // Optimal tour of a small instance by dynamic programming instead of the colonies
+        HeldKarpSolver exact = HeldKarpSolver(adj_mat.view());
+#ifdef _OPENMP
+        exact.set_threads(config.get_int("threads", omp_get_max_threads()));
+#endif
+        auto optimum = exact.solve();
+        if (rank == 0) {
+            print_path(optimum.second, optimum.first);
+        }
+        adj_mat.release();
+        MPI_Finalize();
+        return 0;
     }
 
-    MPI_Barrier(MPI_COMM_WORLD);  // Wait until xml file is read
-    for (int i = 0; i < adj_mat.size(); i++) {
-        MPI_Bcast(adj_mat[i].data(), adj_mat[i].size(), MPI_DOUBLE, 0, MPI_COMM_WORLD);        // Broadcast the adjacency matrix to all processes
+    for (int i = 0; i < pheromones.size(); i++) {
         MPI_Bcast(pheromones[i].data(), pheromones[i].size(), MPI_DOUBLE, 0, MPI_COMM_WORLD);  // Broadcast the pheromones table to all processes
     }
 
-    MPI_PACS pacs = MPI_PACS(-3.0, 0.3, 2.0, 100.0, 0.6);
-    pacs.set_adj_mat(adj_mat);
-    pacs.set_pheromones(pheromones);
+    // Held-Karp lower bound of the tour length, the run stops once the best tour is within the gap of it
+    int bound_iterations = config.get_int("bound-iterations", 1000);
+    double bound = 0.0;
+    if (bound_iterations > 0) {
+        OneTreeBound one_tree = OneTreeBound(adj_mat.view());
+        bound = one_tree.compute(bound_iterations);
+    }
+
+    // Invocation of PACS algorithm with the pheromone table in the chosen precision
+    std::pair<double, Path> p;
+    std::string precision = config.get_string("pheromone-precision", "double");
+    if (precision == "float") {
+        p = run_colony<float>(config, adj_mat.view(), pheromones, bound, rank);
+    } else if (precision == "fixed16") {
+        p = run_colony<uint16_t>(config, adj_mat.view(), pheromones, bound, rank);
+    } else if (precision == "double") {
+        p = run_colony<double>(config, adj_mat.view(), pheromones, bound, rank);
+    } else {
+        if (rank == 0) {
+            std::cerr << "Error: unknown pheromone precision " << precision << ", expected double, float or fixed16" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
-    // Invocation of PACS algorithm
-    auto p = pacs.run(10, 1000, n, 80, 10.0);
     double global_best_cost;
     MPI_Barrier(MPI_COMM_WORLD);
     MPI_Allreduce(&p.first, &global_best_cost, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
 
     if (global_best_cost == p.first) {
-        print_path(p.second, p.first);
+        print_path(p.second, p.first, bound);
     }
 
+    adj_mat.release();
     MPI_Finalize();  // Finalize the MPI environment
     return 0;
 }
 
+/**
+ * Run the colonies of the instance, one per process
+ *
+ * @param config The options of the colony
+ * @param adj_mat The adjacency matrix
+ * @param pheromones The initial pheromones table
+ * @param bound The lower bound of the tour length, 0 if not computed
+ * @param rank The rank of the process
+ * @tparam Pheromone The storage type of the pheromones table
+ */
+template <typename Pheromone>
+std::pair<double, Path> run_colony(SolverConfig &config, MatrixView<double> adj_mat, const Matrix &pheromones, double bound, int rank) {
+    typedef MPI_PACS<Pheromone> PACS;
+    bool async = config.get_string("sync", config.positional(2, "sync")) == "async";
+    PACS pacs = PACS(config.get_double("beta", -3.0), config.get_double("rho", 0.3), config.get_double("theta", 2.0), config.get_double("q", 100.0), config.get_double("tau", 0.6));
+    pacs.set_adj_mat(adj_mat);
+    pacs.set_pheromone_rounding(config.get_string("pheromone-rounding", "nearest") == "stochastic" ? PheromoneRounding::STOCHASTIC : PheromoneRounding::NEAREST);
+    pacs.set_pheromones(pheromones);
+    pacs.set_sync_mode(async ? PACS::SYNC_MODE::ASYNCHRONOUS : PACS::SYNC_MODE::SYNCHRONOUS);
+    if (config.has("seed")) {
+        pacs.set_seed(config.get_int("seed", 0));
+    }
+    if (bound > 0) {
+        pacs.set_lower_bound(bound, config.get_double("gap", 0.0));
+    }
+
+    int num_ants = config.get_int("ants", 10);
+    int num_iter = config.get_int("iterations", 1000);
+    int comm_freq = config.get_int("comm-freq", 80);
+    double time_limit = config.get_double("time-limit", 10.0);
+    bool print_config = config.get_bool("print-config", false);
+    if (rank == 0) {
+        for (const std::string &key : config.unused()) {
+            std::cerr << "Warning: unknown option --" << key << std::endl;
+        }
+        if (print_config) {
+            config.print(std::cout);
+        }
+    }
+    return pacs.run(num_ants, num_iter, adj_mat.size(), comm_freq, time_limit);
+}
+
 /**
  * Parse the xml file
  *
@@ -108,28 +228,33 @@ void print_table(const Matrix &table, bool like_float) {
 }
 
 /**
- * Parse the command line arguments
+ * Count the vertices of the xml file
  *
- * @param argc The number of arguments
- * @param argv The arguments
- * @param n The number of vertecies return variable
- * @param filename The name of the xml file return variable
+ * @param filename The name of the xml file
  */
-void parse_args(int argc, char **argv, int &n, char *&filename) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <n> <filename>" << std::endl;
+int count_vertices(const char *filename) {
+    pugi::xml_document doc;
+    if (!doc.load_file(filename)) {
+        std::cerr << "Error: File not found" << std::endl;
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
-    n = std::stoi(argv[1]);
-    filename = argv[2];
+
+    int n = 0;
+    pugi::xml_node graph = doc.child("travellingSalesmanProblemInstance").child("graph");
+    for (auto node = graph.child("vertex"); node; node = node.next_sibling("vertex")) {
+        n++;
+    }
+    return n;
 }
 
 /**
  * Pretty print the path
  *
  * @param path The path to be printed
+ * @param cost The cost of the path
+ * @param bound The lower bound of the tour length, the gap to it is printed if it is positive
  */
-void print_path(const Path &path, int cost) {
+void print_path(const Path &path, int cost, double bound) {
     std::cout << "Path< ";
     for (auto it = path.begin(); it != path.end(); it++) {
         std::cout << *it;
@@ -139,4 +264,182 @@ void print_path(const Path &path, int cost) {
     }
     std::cout << " >End" << std::endl;
     std::cout << "Cost: " << cost << std::endl;
-}
\ No newline at end of file
+    if (bound > 0) {
+        std::cout << "Lower bound: " << bound << " Gap: " << std::max(0.0, 100 * (cost - bound) / bound) << "%" << std::endl;
+    }
+}
+
+/**
+ * Race parameter configurations of the colony on a class of instances and print the best one
+ * in the config file format. Every process runs its share of the configurations as a single colony,
+ * so comm-freq is not tuned.
+ *
+ * @param config The options, --tune-instances <instance,instance,...> and the tuning options
+ * @param rank The rank of the process
+ */
+void tune(SolverConfig &config, int rank) {
+    std::vector<std::string> filenames;
+    std::stringstream list(config.get_string("tune-instances", ""));
+    for (std::string filename; std::getline(list, filename, ',');) {
+        filenames.push_back(filename);
+    }
+
+    // The instances are stored once per node and shared by all its processes
+    std::vector<std::unique_ptr<SharedMatrix<double>>> instances;
+    for (std::string &filename : filenames) {
+        int n;
+        Matrix vertecies;
+        if (rank == 0) {
+            n = count_vertices(filename.c_str());
+            vertecies = Matrix(n, std::vector<double>(n, 0.0));
+            parse_xml(filename.c_str(), vertecies);
+        }
+        MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        instances.push_back(std::make_unique<SharedMatrix<double>>(n, n));
+        instances.back()->distribute(vertecies);
+    }
+
+    int num_ants = config.get_int("ants", 10);
+    int num_iter = config.get_int("iterations", 1000);
+    double time_limit = config.get_double("time-limit", 10.0);
+    std::vector<TunedParameter> parameters = {
+        with_range({"beta", -5.0, -1.0}, config.get_string("tune-beta", "")),
+        with_range({"rho", 0.05, 0.9}, config.get_string("tune-rho", "")),
+        with_range({"theta", 0.5, 5.0}, config.get_string("tune-theta", "")),
+        with_range({"q", 10.0, 1000.0, false, true}, config.get_string("tune-q", "")),
+        with_range({"tau", 0.1, 1.0}, config.get_string("tune-tau", "")),
+    };
+
+    RacingTuner::Evaluation evaluate = [&](const ParameterConfiguration &configuration, int instance, unsigned seed) {
+        MatrixView<double> adj_mat = instances[instance]->view();
+        int n = adj_mat.size();
+        MPI_PACS pacs = MPI_PACS(configuration.at("beta"), configuration.at("rho"), configuration.at("theta"), configuration.at("q"), configuration.at("tau"), MPI_COMM_SELF);
+        pacs.set_adj_mat(adj_mat);
+        pacs.set_pheromones(Matrix(n, std::vector<double>(n, 1.0)));
+        pacs.set_seed(seed);
+        return pacs.run(num_ants, num_iter, n, num_iter, time_limit).first;
+    };
+
+    RacingTuner tuner = RacingTuner(parameters);
+    tuner.set_confidence(config.get_double("tune-confidence", 0.95));
+    tuner.set_first_test(config.get_int("tune-first-test", 5));
+    int num_candidates = config.get_int("tune-candidates", 20);
+    int budget = config.get_int("tune-budget", 400);
+    unsigned seed = config.get_int("seed", 0);
+    if (rank == 0) {
+        for (const std::string &key : config.unused()) {
+            std::cerr << "Warning: unknown option --" << key << std::endl;
+        }
+    }
+    ParameterConfiguration best = tuner.race(num_candidates, budget, filenames.size(), evaluate, seed);
+    tuner.print(std::cout);
+
+    if (rank == 0) {
+        std::cout << "# Best configuration" << std::endl;
+        std::cout << "ants = " << num_ants << std::endl;
+        std::cout << "iterations = " << num_iter << std::endl;
+        for (auto &[name, value] : best) {
+            std::cout << name << " = " << value << std::endl;
+        }
+    }
+
+    for (auto &instance : instances) {
+        instance->release();
+    }
+}
+
+/**
+ * Parse a TSPLIB file with a NODE_COORD_SECTION
+ *
+ * @param filename The name of the TSPLIB file
+ * @param cities The coordinates of the cities to be filled
+ * @param rounding The rounding of the distances given by the EDGE_WEIGHT_TYPE
+ */
+void parse_tsplib(const char *filename, std::vector<Point> &cities, DistanceRounding &rounding) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Error: File not found" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    int n = 0;
+    rounding = DistanceRounding::NEAREST;
+    std::string line;
+    while (std::getline(file, line) && line.find("NODE_COORD_SECTION") == std::string::npos) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string key = line.substr(0, colon), value = line.substr(colon + 1);
+        key.erase(key.find_last_not_of(" \t\r") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+        if (key == "NAME" || key == "COMMENT") {
+            std::cout << (key == "NAME" ? "Name: " : "Description: ") << value << std::endl;
+        } else if (key == "DIMENSION") {
+            n = std::stoi(value);
+        } else if (key == "EDGE_WEIGHT_TYPE") {
+            if (value == "CEIL_2D") {
+                rounding = DistanceRounding::CEIL;
+            } else if (value != "EUC_2D") {
+                std::cerr << "Error: EDGE_WEIGHT_TYPE " << value << " is not supported, only EUC_2D and CEIL_2D" << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        }
+    }
+
+    cities.resize(n);
+    int id;
+    for (int i = 0; i < n; i++) {
+        if (!(file >> id >> cities[i].x >> cities[i].y)) {
+            std::cerr << "Error: NODE_COORD_SECTION has fewer than " << n << " cities" << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+}
+
+/**
+ * Solve a coordinate instance by colonies on the regions of a geometric decomposition, one region per process,
+ * so that instances too large for the adjacency matrix of every process can be solved
+ *
+ * @param config The options, the colony options and --repair-rounds
+ * @param filename The name of the TSPLIB file
+ * @param rank The rank of the process
+ */
+void partition(SolverConfig &config, const std::string &filename, int rank) {
+    int n;
+    int rounding;
+    std::vector<Point> cities;
+    if (rank == 0) {
+        DistanceRounding type;
+        parse_tsplib(filename.c_str(), cities, type);
+        n = cities.size();
+        rounding = (int)type;
+    }
+    MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&rounding, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    cities.resize(n);
+    MPI_Bcast(cities.data(), 2 * n, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    PartitionedPACS pacs = PartitionedPACS(cities, config.get_double("beta", -3.0), config.get_double("rho", 0.3), config.get_double("theta", 2.0), config.get_double("q", 100.0), config.get_double("tau", 0.6));
+    pacs.set_rounding((DistanceRounding)rounding);
+    pacs.set_repair_rounds(config.get_int("repair-rounds", 2));
+    if (config.has("seed")) {
+        pacs.set_seed(config.get_int("seed", 0));
+    }
+    int num_ants = config.get_int("ants", 10);
+    int num_iter = config.get_int("iterations", 1000);
+    double time_limit = config.get_double("time-limit", 10.0);
+    bool print_config = config.get_bool("print-config", false);
+    if (rank == 0) {
+        for (const std::string &key : config.unused()) {
+            std::cerr << "Warning: unknown option --" << key << std::endl;
+        }
+        if (print_config) {
+            config.print(std::cout);
+        }
+    }
+
+    auto p = pacs.run(num_ants, num_iter, time_limit);
+    if (rank == 0) {
+        print_path(p.second, p.first);
+    }
+}
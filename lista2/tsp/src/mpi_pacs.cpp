@@ -4,6 +4,7 @@
 #include <math.h>
 #include <mpi.h>
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
 #include <map>
@@ -11,11 +12,24 @@
 
 #include "rng.hpp"
 
-std::pair<double, Path> MPI_PACS::run(int num_ants, int num_iter, int num_cities, int comm_freq, double timeout) {
-    IntRNG city_rng(0, num_cities - 1);
+template <typename Pheromone>
+std::pair<double, Path> MPI_PACS<Pheromone>::run(int num_ants, int num_iter, int num_cities, int comm_freq, double timeout) {
+    std::mt19937 gen(seed);
+    IntRNG city_rng(0, num_cities - 1, gen());
+    DoubleRNG action(0.0, 1.0, gen());
 
     auto best_cost = std::numeric_limits<double>::max();  // Start with a high cost
     auto best_path = Path();                              // Start with empty path
+    auto best_path_cost = best_cost;                      // Cost of best_path, best_cost may come from another process
+
+    std::vector<Path> paths(num_ants);
+    std::vector<double> costs(num_ants);
+
+    if (sync_mode == SYNC_MODE::ASYNCHRONOUS) {
+        MPI_Comm_dup(comm, &exchange_comm);
+        exchanges_started = 0;
+    }
+    int next_exchange = 0;  // First iteration of the next asynchronous exchange
 
     double start = MPI_Wtime();
 
@@ -24,150 +38,326 @@ std::pair<double, Path> MPI_PACS::run(int num_ants, int num_iter, int num_cities
             break;
         }
         for (int i = 0; i < num_ants; i++) {
-            int start = city_rng.getNext();                // generate random starting point for single ant
-            auto path = generate_path(start, num_cities);  // generate path for single ant
-            auto path_cost = cost(path);                   // calculate the cost of the path
-            if (path_cost < best_cost) {                   // update the best path if the current path is better
-                best_cost = path_cost;
-                best_path = path;
+            int start = city_rng.getNext();                       // generate random starting point for single ant
+            paths[i] = generate_path(start, num_cities, action);  // generate path for single ant
+            costs[i] = cost(paths[i]);                            // calculate the cost of the path
+            if (costs[i] < best_cost) {                           // update the best path if the current path is better
+                best_cost = costs[i];
+                best_path = paths[i];
+                best_path_cost = costs[i];
             }
-            update_pheromones(path, PHEROMONE_UPDATE_STRATEGY::LOCAL);  // update pheromones::local
         }
-        update_pheromones(best_path, PHEROMONE_UPDATE_STRATEGY::GLOBAL);  // update pheromones::global
+        update_pheromones(paths, costs, PHEROMONE_UPDATE_STRATEGY::LOCAL);                   // update pheromones::local
+        update_pheromones({best_path}, {best_path_cost}, PHEROMONE_UPDATE_STRATEGY::GLOBAL);  // update pheromones::global
 
-        if (iter % comm_freq == 0) {
-            MPI_Barrier(MPI_COMM_WORLD);
+        if (sync_mode == SYNC_MODE::ASYNCHRONOUS) {
+            // Swap in the pheromones received since the last iteration, never wait for the other colonies
+            // The best cost of a completed exchange is the same on all processes, so they all stop after the same exchange
+            if (progress_exchange(best_cost, false) && within_gap(exchange_best.cost)) {
+                break;
+            }
+            if (exchange_state == EXCHANGE_STATE::IDLE && iter >= next_exchange) {
+                start_exchange(best_path_cost);
+                next_exchange = iter + comm_freq;
+            }
+        } else if (iter % comm_freq == 0) {
+            MPI_Barrier(comm);
             double global_best_cost;
-            MPI_Allreduce(&best_cost, &global_best_cost, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+            MPI_Allreduce(&best_cost, &global_best_cost, 1, MPI_DOUBLE, MPI_MIN, comm);
             int best_cost_rank = rank;
             if (global_best_cost == best_cost) {
                 for (int i = 0; i < num_procs; i++) {
                     if (i != rank) {
-                        MPI_Send(&rank, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+                        MPI_Send(&rank, 1, MPI_INT, i, 0, comm);
                     }
                 }
             } else {
                 MPI_Status status;
-                MPI_Recv(&best_cost_rank, 1, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
-            }
-            MPI_Barrier(MPI_COMM_WORLD);
-            for (int i = 0; i < pheromones.size(); i++) {
-                MPI_Bcast(pheromones[i].data(), pheromones[i].size(), MPI_DOUBLE, best_cost_rank, MPI_COMM_WORLD);  // Broadcast the pheromones table to all processes
+                MPI_Recv(&best_cost_rank, 1, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &status);
             }
+            MPI_Barrier(comm);
+            MPI_Bcast(pheromones.data(), pheromones.storage_size(), pheromones.mpi_type(), best_cost_rank, comm);  // Broadcast the pheromones table to all processes
+            refresh_choice();
             best_cost = global_best_cost;
+            if (within_gap(best_cost)) {
+                break;
+            }
         }
     }
 
-    return {best_cost, best_path};
+    if (sync_mode == SYNC_MODE::ASYNCHRONOUS) {
+        finish_exchanges(best_path_cost, best_cost);
+        MPI_Comm_free(&exchange_comm);
+    }
+
+    return {best_path_cost, best_path};
 }
-MPI_PACS::MPI_PACS(double beta, double rho, double theta, double q, double tau) {
+
+template <typename Pheromone>
+MPI_PACS<Pheromone>::MPI_PACS(double beta, double rho, double theta, double q, double tau, MPI_Comm comm) : comm(comm) {
     BETA = beta;
     RHO = rho;
     THETA = theta;
     Q = q;
     TAU = tau;
-    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(comm, &num_procs);
+    MPI_Comm_rank(comm, &rank);
+    seed = std::random_device()();
 }
 
-void MPI_PACS::set_adj_mat(const Matrix &adj_mat) {
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::set_adj_mat(MatrixView<double> adj_mat) {
     this->adj_mat = adj_mat;
+    symmetric = true;
+    for (int i = 0; i < adj_mat.size() && symmetric; i++) {
+        for (int j = 0; j < i; j++) {
+            if (adj_mat[i][j] != adj_mat[j][i]) {
+                symmetric = false;
+                break;
+            }
+        }
+    }
 }
 
-void MPI_PACS::set_pheromones(const Matrix &pheromones) {
-    this->pheromones = pheromones;
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::set_pheromones(const Matrix &pheromones) {
+    int n = pheromones.size();
+    double max_value = TAU;
+    if (PheromoneTraits<Pheromone>::fixed_point) {
+        double shortest_edges = 0.0;
+        for (int i = 0; i < n; i++) {
+            double shortest = std::numeric_limits<double>::max();
+            for (int j = 0; j < n; j++) {
+                max_value = std::max(max_value, pheromones[i][j]);
+                if (j != i) shortest = std::min(shortest, adj_mat[i][j]);
+            }
+            shortest_edges += n > 1 ? shortest : 0.0;
+        }
+        if (shortest_edges > 0) {
+            max_value = std::max(max_value, THETA * Q / (RHO * shortest_edges));
+        }
+    }
+    this->pheromones = PheromoneMatrix<Pheromone>(n, symmetric, 0.0, max_value, rounding);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < (symmetric ? i + 1 : n); j++) {
+            this->pheromones.set(i, j, pheromones[i][j]);
+        }
+    }
+    refresh_choice();
+}
+
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::set_sync_mode(SYNC_MODE mode) {
+    sync_mode = mode;
+}
+
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::set_pheromone_rounding(PheromoneRounding rounding) {
+    this->rounding = rounding;
+}
+
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::set_seed(unsigned seed) {
+    this->seed = seed + rank;
 }
 
-Path MPI_PACS::generate_path(int start, int n) {
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::set_lower_bound(double bound, double gap) {
+    lower_bound = bound;
+    target_gap = gap;
+}
+
+template <typename Pheromone>
+bool MPI_PACS<Pheromone>::within_gap(double cost) const {
+    return lower_bound > 0 && cost <= lower_bound * (1 + target_gap) + 1e-9 * lower_bound;
+}
+
+template <typename Pheromone>
+Path MPI_PACS<Pheromone>::generate_path(int start, int n, DoubleRNG &action) {
     Path path;
+    path.reserve(n + 1);
     path.push_back(start);  // Random starting point
-    std::list<int> unvisited = construct_unvisited_list(start, n);
-    auto current = start, next_dest = -1;
-
-    DoubleRNG action = DoubleRNG(0.0, 1.0);
+    unvisited.clear();
+    for (int i = 0; i < n; i++) {
+        if (i != start) unvisited.push_back(i);
+    }
+    wheel.resize(n);
+    int current = start;
 
     while (unvisited.size() > 0) {
-        auto best = std::numeric_limits<double>::max();
-        for (auto city : unvisited) {
-            if (action.getNext() < 0.5) {
-                // If the random number is less than 0.5, use greedy selection
-                double prob = pheromones[current][city] * pow((1 / adj_mat[current][city]), BETA);
-                if (prob < best) {
-                    best = prob;
-                    next_dest = city;
+        const Choice *row = choice.data() + (size_t)current * n;
+        int m = unvisited.size();
+        int next = 0;
+        double u = action.getNext();
+        if (u < Q0) {
+            // Greedy selection of the best edge
+            Choice best = row[unvisited[0]];
+            for (int k = 1; k < m; k++) {
+                if (row[unvisited[k]] > best) {
+                    best = row[unvisited[k]];
+                    next = k;
                 }
+            }
+        } else {
+            // Roulette wheel selection, the same random number rescaled to [0, 1)
+            double total = 0.0;
+            for (int k = 0; k < m; k++) {
+                total += row[unvisited[k]];
+                wheel[k] = total;
+            }
+            double target = (u - Q0) / (1 - Q0);
+            if (total > 0) {
+                next = std::upper_bound(wheel.begin(), wheel.begin() + m, target * total) - wheel.begin();
             } else {
-                // Otherwise, use probabilistic selection
-                double full_prob = 0.0;
-                double prob = pheromones[current][city] * pow((1 / adj_mat[current][city]), BETA);  // probability of moving to the city
-                for (auto city_id : unvisited) {
-                    if (city_id == city) continue;
-                    full_prob += pheromones[current][city_id] * pow((1 / adj_mat[current][city_id]), BETA);
-                }
-                if (prob / full_prob < best) {
-                    best = prob / full_prob;
-                    next_dest = city;
-                }
+                next = target * m;  // All choices vanished, every city is as good
             }
+            next = std::min(next, m - 1);
         }
-        if (current != next_dest) {
-            unvisited.remove(next_dest);  // remove the city from the unvisited list
-            path.push_back(next_dest);    // move to the next city
-            current = next_dest;          // update the current city
-        }
+        current = unvisited[next];
+        unvisited[next] = unvisited.back();  // remove the city from the unvisited cities
+        unvisited.pop_back();
+        path.push_back(current);  // move to the next city
     }
     path.push_back(start);  // comback to the start
     return path;
 }
 
-double MPI_PACS::cost(const Path &path) {
+template <typename Pheromone>
+double MPI_PACS<Pheromone>::cost(const Path &path) {
     double cost = 0.0;
-    for (auto it = path.begin(); it != path.end(); it++) {
-        auto next = std::next(it);
-        if (next == path.end()) continue;
-        cost += adj_mat[*it][*next];
+    for (size_t i = 1; i < path.size(); i++) {
+        cost += adj_mat[path[i - 1]][path[i]];
     }
     return cost;
 }
 
-void MPI_PACS::update_pheromones(const Path &path, PHEROMONE_UPDATE_STRATEGY strategy) {
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::update_pheromones(const std::vector<Path> &paths, const std::vector<double> &costs, PHEROMONE_UPDATE_STRATEGY strategy) {
     switch (strategy) {
         case PHEROMONE_UPDATE_STRATEGY::LOCAL:
-            local_update_strategy(path);
+            local_update_strategy(paths);
             break;
         case PHEROMONE_UPDATE_STRATEGY::GLOBAL:
-            global_update_strategy(path);
+            global_update_strategy(paths, costs);
             break;
         default:
             throw std::runtime_error("Invalid pheromone update strategy");
             break;
     }
+    for (const Path &path : paths) {
+        for (size_t i = 1; i < path.size(); i++) {
+            refresh_choice(path[i - 1], path[i]);
+        }
+    }
 }
 
 // Helper functions
 
-void MPI_PACS::local_update_strategy(const Path &path) {
-    auto num_cities = path.size();
-    auto path_cost = cost(path);
-    for (auto it = path.begin(); it != path.end(); it++) {
-        auto next = std::next(it);
-        if (next == path.end()) continue;
-        pheromones[*it][*next] = (1 - RHO) * pheromones[*it][*next] + (RHO * TAU);
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::local_update_strategy(const std::vector<Path> &paths) {
+    edges.clear();
+    for (const Path &path : paths) {
+        for (size_t i = 1; i < path.size(); i++) {
+            edges.push_back(pheromones.index(path[i - 1], path[i]));
+        }
+    }
+    std::sort(edges.begin(), edges.end());  // walk the table in memory order, equal edges become adjacent
+
+    for (size_t i = 0; i < edges.size();) {
+        size_t k = i;
+        while (k < edges.size() && edges[k] == edges[i]) k++;
+        double decay = pow(1 - RHO, k - i);
+        pheromones.store(edges[i], decay * pheromones.at(edges[i]) + (1 - decay) * TAU);
+        i = k;
     }
 }
 
-void MPI_PACS::global_update_strategy(const Path &path) {
-    auto path_cost = cost(path);
-    for (auto it = path.begin(); it != path.end(); it++) {
-        auto next = std::next(it);
-        if (next == path.end()) continue;
-        pheromones[*it][*next] = (1 - RHO) * pheromones[*it][*next] + THETA * (Q / path_cost);
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::global_update_strategy(const std::vector<Path> &paths, const std::vector<double> &costs) {
+    for (size_t p = 0; p < paths.size(); p++) {
+        const Path &path = paths[p];
+        double deposit = THETA * (Q / costs[p]);
+        for (size_t i = 1; i < path.size(); i++) {
+            pheromones.set(path[i - 1], path[i], (1 - RHO) * pheromones(path[i - 1], path[i]) + deposit);
+        }
     }
 }
 
-Path MPI_PACS::construct_unvisited_list(int start, int n) {
-    std::list<int> unvisited;
-    for (int i = 0; i < n; i++)
-        if (i != start) unvisited.push_back(i);
-    return unvisited;
-}
\ No newline at end of file
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::start_exchange(double own_cost) {
+    exchange_local = {own_cost, rank};
+    MPI_Iallreduce(&exchange_local, &exchange_best, 1, MPI_DOUBLE_INT, MPI_MINLOC, exchange_comm, &exchange_request);
+    exchange_state = EXCHANGE_STATE::BEST;
+    exchanges_started++;
+}
+
+template <typename Pheromone>
+bool MPI_PACS<Pheromone>::progress_exchange(double &best_cost, bool wait) {
+    while (exchange_state != EXCHANGE_STATE::IDLE) {
+        int done = 1;
+        if (wait) {
+            MPI_Wait(&exchange_request, MPI_STATUS_IGNORE);
+        } else {
+            MPI_Test(&exchange_request, &done, MPI_STATUS_IGNORE);
+        }
+        if (!done) {
+            return false;
+        }
+
+        if (exchange_state == EXCHANGE_STATE::BEST) {
+            // The best colony sends a snapshot of its pheromones, the others receive into the staging buffer
+            staging.resize(pheromones.storage_size());
+            if (exchange_best.rank == rank) {
+                std::copy(pheromones.data(), pheromones.data() + pheromones.storage_size(), staging.begin());
+            }
+            MPI_Ibcast(staging.data(), staging.size(), pheromones.mpi_type(), exchange_best.rank, exchange_comm, &exchange_request);
+            exchange_state = EXCHANGE_STATE::TABLE;
+        } else {
+            if (exchange_best.rank != rank) {
+                pheromones.swap(staging);
+                refresh_choice();
+            }
+            best_cost = std::min(best_cost, exchange_best.cost);
+            exchange_state = EXCHANGE_STATE::IDLE;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::finish_exchanges(double own_cost, double &best_cost) {
+    int target;
+    MPI_Allreduce(&exchanges_started, &target, 1, MPI_INT, MPI_MAX, comm);
+    progress_exchange(best_cost, true);
+    while (exchanges_started < target) {
+        start_exchange(own_cost);
+        progress_exchange(best_cost, true);
+    }
+}
+
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::refresh_choice() {
+    int n = pheromones.num_cities();
+    choice.resize((size_t)n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < (symmetric ? i + 1 : n); j++) {
+            refresh_choice(i, j);
+        }
+    }
+}
+
+template <typename Pheromone>
+void MPI_PACS<Pheromone>::refresh_choice(int i, int j) {
+    int n = pheromones.num_cities();
+    // Capped so that the prefix sums stay finite for cities at distance 0
+    double value = i == j ? 0.0 : std::min(pheromones(i, j) * pow(adj_mat[i][j], BETA), 1e30);
+    choice[(size_t)i * n + j] = value;
+    if (symmetric) {
+        choice[(size_t)j * n + i] = value;
+    }
+}
+
+template class MPI_PACS<double>;
+template class MPI_PACS<float>;
+template class MPI_PACS<uint16_t>;
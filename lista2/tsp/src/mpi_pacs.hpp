@@ -1,19 +1,38 @@
 #pragma once
-#include <list>
+#include <mpi.h>
+
 #include <vector>
 
+#include "pheromone_matrix.hpp"
+#include "rng.hpp"
+#include "shared_matrix.hpp"
+
 // 2d vector wrapper type
 typedef std::vector<std::vector<double>> Matrix;
 
-// list of integers wrapper type
-typedef std::list<int> Path;
+// Sequence of visited cities, the first city is repeated at the end
+typedef std::vector<int> Path;
 
 /**
  * Parallel Ant Colony System.
  * Using MPI for communication between colonies
+ * @tparam Pheromone storage type of the pheromone table: double, float or uint16_t (fixed point),
+ *                   the exchanges of the colonies send the table in this type
  */
+template <typename Pheromone = double>
 class MPI_PACS {
    public:
+    /**
+     * Synchronization modes of the colonies
+     * @param SYNCHRONOUS: every comm_freq iterations all processes stop and take the pheromones of the best colony
+     * @param ASYNCHRONOUS: the exchange runs on nonblocking collectives while the ants keep building tours,
+     *                      the received pheromones are swapped in at the first iteration boundary after they arrive
+     */
+    enum class SYNC_MODE {
+        SYNCHRONOUS = 0,
+        ASYNCHRONOUS = 1,
+    };
+
     /**
      * Set the parameters for the ACO algorithm
      * @param beta distance importance
@@ -21,18 +40,44 @@ class MPI_PACS {
      * @param theta pheromone deposit amount
      * @param q some constant
      * @param tau initial pheromone level
+     * @param comm communicator of the colonies
      */
-    MPI_PACS(double beta, double rho, double theta, double q, double tau);
+    MPI_PACS(double beta, double rho, double theta, double q, double tau, MPI_Comm comm = MPI_COMM_WORLD);
     /**
-     * Set the adjacency matrix
+     * Set the adjacency matrix, the matrix is not copied and must outlive the solver.
+     * Must be called before set_pheromones, a symmetric matrix selects the half pheromone storage.
      * @param adj_mat adjacency matrix
      */
-    void set_adj_mat(const Matrix &adj_mat);
+    void set_adj_mat(MatrixView<double> adj_mat);
     /**
-     * Set the pheromones matrix
+     * Set the pheromones matrix.
+     * A fixed point table covers up to the largest of the initial levels, tau and the limit theta * q / (rho * L)
+     * of the global update, L the sum of the shortest edges of the cities, a lower bound of every tour.
      * @param pheromones pheromones matrix
      */
     void set_pheromones(const Matrix &pheromones);
+    /**
+     * Set the synchronization mode, synchronous by default
+     * @param mode synchronization mode
+     */
+    void set_sync_mode(SYNC_MODE mode);
+    /**
+     * Set the rounding of a fixed point pheromone table, nearest by default. Must be called before set_pheromones
+     * @param rounding the rounding
+     */
+    void set_pheromone_rounding(PheromoneRounding rounding);
+    /**
+     * Seed the random choices of the ants, a random seed is used by default
+     * @param seed the seed, the rank is added so that the colonies differ
+     */
+    void set_seed(unsigned seed);
+    /**
+     * Stop as soon as the best tour is within the gap of a lower bound, checked at the exchanges of the colonies
+     * so that all processes stop at the same exchange
+     * @param bound lower bound of the tour length, e.g. the 1-tree bound
+     * @param gap the relative gap, 0 stops only at a tour as short as the bound
+     */
+    void set_lower_bound(double bound, double gap);
 
     /**
      * Run the ACO algorithm
@@ -41,21 +86,62 @@ class MPI_PACS {
      * @param num_cities number of cities
      * @param comm_freq communication frequency
      * @param timeout maximum time to run the algorithm in seconds
+     * @return the best path found by this process and its length, a better length received from another process is not returned
      */
     std::pair<double, Path> run(int num_ants, int num_iter, int num_cities, int comm_freq, double timeout);
 
    private:
-    double BETA = -2.0;  // Distance importance
+    double BETA = -2.0;  // Distance importance, the weight of an edge is pheromone * distance^beta
+    double Q0 = 0.5;     // Probability of the greedy choice of the next city, otherwise the roulette wheel
     double RHO = 0.3;    // Evaporation rate
     double THETA = 3.0;  // Pheromone deposit amount
     double TAU = 0.6;    // Initial pheromone level
     double Q = 100.0;    // Some constant
 
+    MPI_Comm comm;  // Communicator of the colonies
     int num_procs;  // Number of MPI processes
     int rank;       // Rank of the MPI process
+    unsigned seed;  // Seed of the random choices of this process
+
+    double lower_bound = 0;  // Lower bound of the tour length, 0 if unknown
+    double target_gap = 0;   // Relative gap to the bound at which the run stops
+
+    typedef typename PheromoneTraits<Pheromone>::choice_type Choice;
+
+    MatrixView<double> adj_mat;                               // Adjacency matrix, shared by the processes of the node
+    bool symmetric = false;                                   // The adjacency matrix is symmetric
+    PheromoneMatrix<Pheromone> pheromones;                    // Pheromones matrix
+    PheromoneRounding rounding = PheromoneRounding::NEAREST;  // Rounding of a fixed point pheromone table
+    std::vector<Choice> choice;                               // Choice table, pheromone * distance^beta, full rows of n values
+    std::vector<size_t> edges;                                // Buffer of the pheromone indices of the batched local update
+    std::vector<int> unvisited;                               // Buffer of the cities not visited yet by the ant
+    std::vector<double> wheel;                                // Buffer of the prefix sums of the roulette wheel
+
+    /**
+     * States of the asynchronous exchange
+     * @param IDLE: no exchange in flight
+     * @param BEST: the best cost and its rank are being reduced
+     * @param TABLE: the pheromones of the best rank are being broadcast into the staging buffer
+     */
+    enum class EXCHANGE_STATE {
+        IDLE = 0,
+        BEST = 1,
+        TABLE = 2,
+    };
+
+    struct RankedCost {
+        double cost;
+        int rank;
+    };
 
-    Matrix adj_mat;     // Adjacency matrix
-    Matrix pheromones;  // Pheromones matrix
+    SYNC_MODE sync_mode = SYNC_MODE::SYNCHRONOUS;           // Synchronization mode of the colonies
+    MPI_Comm exchange_comm = MPI_COMM_NULL;                 // Communicator of the asynchronous exchanges
+    EXCHANGE_STATE exchange_state = EXCHANGE_STATE::IDLE;  // Phase of the exchange in flight
+    MPI_Request exchange_request = MPI_REQUEST_NULL;       // Request of the phase in flight
+    RankedCost exchange_local;                             // Best cost of this colony sent in the exchange
+    RankedCost exchange_best;                              // Best cost of all colonies and its rank
+    std::vector<Pheromone> staging;                        // Pheromones received in the exchange
+    int exchanges_started = 0;                             // Number of exchanges started by this process
 
     /**
      * Pheromone update strategies
@@ -68,11 +154,15 @@ class MPI_PACS {
     };
 
     /**
-     * Generate a path for an ant
+     * Generate a path for an ant.
+     * Every step draws one random number, below Q0 the unvisited city with the largest choice is taken,
+     * otherwise the number is rescaled to spin a roulette wheel of the prefix sums of the choices,
+     * one pass over the unvisited cities and a binary search.
      * @param start starting point
      * @param n number of cities
+     * @param action random numbers choosing between the greedy and the probabilistic selection
      */
-    Path generate_path(int start, int n);
+    Path generate_path(int start, int n, DoubleRNG &action);
 
     /**
      * Calculate the cost of a path
@@ -81,28 +171,63 @@ class MPI_PACS {
     double cost(const Path &path);
 
     /**
-     * Update the pheromones based on the path taken by an ant
-     * @param path path taken by an ant
+     * Update the pheromones based on the paths taken by the ants, all paths are applied in one batch
+     * @param paths paths taken by the ants
+     * @param costs costs of the paths, as computed when the paths were generated
      * @param strategy pheromone update strategy
      */
-    void update_pheromones(const Path &path, PHEROMONE_UPDATE_STRATEGY strategy);
+    void update_pheromones(const std::vector<Path> &paths, const std::vector<double> &costs, PHEROMONE_UPDATE_STRATEGY strategy);
 
     /**
-     * Local update strategy
-     * @param path path taken by an ant
+     * Local update strategy.
+     * The edges of all paths are sorted by their position in the table and an edge used k times
+     * is updated once with the k-fold rule: p = (1 - rho)^k * p + (1 - (1 - rho)^k) * tau
+     * @param paths paths taken by the ants in the iteration
      */
-    void local_update_strategy(const Path &path);
+    void local_update_strategy(const std::vector<Path> &paths);
 
     /**
      * Global update strategy
-     * @param path path taken by an ant
+     * @param paths paths to reinforce
+     * @param costs costs of the paths
      */
-    void global_update_strategy(const Path &path);
+    void global_update_strategy(const std::vector<Path> &paths, const std::vector<double> &costs);
 
     /**
-     * Construct a list of unvisited cities
-     * @param start starting point
-     * @param n number of cities
+     * Start an asynchronous exchange, must be idle
+     * @param own_cost cost of the best path found by this colony
+     */
+    void start_exchange(double own_cost);
+
+    /**
+     * Advance the asynchronous exchange, once it completes the received pheromones replace the local ones
+     * @param best_cost the best known cost, updated with the best cost of all colonies
+     * @param wait block until the exchange completes
+     * @return true if an exchange completed
+     */
+    bool progress_exchange(double &best_cost, bool wait);
+
+    /**
+     * Complete the asynchronous exchanges, collective.
+     * Processes may have started a different number of exchanges, the ones behind start
+     * the missing exchanges so that every nonblocking collective is matched.
+     * @param own_cost cost of the best path found by this colony
+     * @param best_cost the best known cost
+     */
+    void finish_exchanges(double own_cost, double &best_cost);
+
+    /**
+     * Check if the cost is within the target gap of the lower bound
+     */
+    bool within_gap(double cost) const;
+
+    /**
+     * Recompute the whole choice table, after the pheromones were replaced
+     */
+    void refresh_choice();
+
+    /**
+     * Recompute the choice of edge (i, j), and of (j, i) for symmetric instances
      */
-    std::list<int> construct_unvisited_list(int start, int n);
+    void refresh_choice(int i, int j);
 };
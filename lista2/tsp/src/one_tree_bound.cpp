@@ -0,0 +1,133 @@
+#include "one_tree_bound.hpp"
+
+#include <algorithm>
+#include <limits>
+
+OneTreeBound::OneTreeBound(MatrixView<double> adj_mat, MPI_Comm comm) : adj_mat(adj_mat), comm(comm), n(adj_mat.size()) {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+}
+
+double OneTreeBound::distance(int i, int j) const {
+    return std::min(adj_mat[i][j], adj_mat[j][i]);
+}
+
+double OneTreeBound::compute(int max_iter) {
+    double bound = 0.0;
+    tour = false;
+    if (n >= 3 && rank < n) {
+        int special = rank;
+        pi.assign(n, 0.0);
+        double upper = nearest_neighbour_tour();
+        // Polyak step t = lambda * (upper - L) / |g|^2, lambda is halved when the bound stalls
+        double lambda = 2.0;
+        int since_improvement = 0;
+        for (int iter = 0; iter < max_iter && lambda > 1e-6; iter++) {
+            double sum_pi = 0.0;
+            for (double p : pi) sum_pi += p;
+            double value = one_tree(special) - 2 * sum_pi;
+            if (value > bound) {
+                bound = value;
+                since_improvement = 0;
+            } else if (++since_improvement >= std::max(10, n / 2)) {
+                lambda /= 2;
+                since_improvement = 0;
+            }
+
+            double norm = 0.0;
+            for (int i = 0; i < n; i++) {
+                norm += (degree[i] - 2) * (degree[i] - 2);
+            }
+            if (norm == 0) {
+                tour = true;  // Every city has degree 2, the 1-tree is an optimal tour
+                bound = value;
+                break;
+            }
+            double step = lambda * std::max(upper - value, 1e-9 * upper) / norm;
+            for (int i = 0; i < n; i++) {
+                pi[i] += step * (degree[i] - 2);
+            }
+        }
+    }
+
+    struct {
+        double bound;
+        int rank;
+    } local = {bound, rank}, best;
+    MPI_Allreduce(&local, &best, 1, MPI_DOUBLE_INT, MPI_MAXLOC, comm);
+    int best_is_tour = tour;
+    MPI_Bcast(&best_is_tour, 1, MPI_INT, best.rank, comm);
+    tour = best_is_tour;
+    return best.bound;
+}
+
+double OneTreeBound::one_tree(int special) {
+    const double INF = std::numeric_limits<double>::max();
+    degree.assign(n, 0);
+    key.assign(n, INF);
+    parent.assign(n, -1);
+    in_tree.assign(n, 0);
+
+    // Prim's algorithm on the cities but the special one
+    int first = special == 0 ? 1 : 0;
+    key[first] = 0.0;
+    double cost = 0.0;
+    for (int added = 0; added < n - 1; added++) {
+        int u = -1;
+        for (int v = 0; v < n; v++) {
+            if (v != special && !in_tree[v] && (u < 0 || key[v] < key[u])) u = v;
+        }
+        in_tree[u] = 1;
+        if (parent[u] >= 0) {
+            cost += key[u];
+            degree[u]++;
+            degree[parent[u]]++;
+        }
+        for (int v = 0; v < n; v++) {
+            if (v == special || in_tree[v]) continue;
+            double d = distance(u, v) + pi[u] + pi[v];
+            if (d < key[v]) {
+                key[v] = d;
+                parent[v] = u;
+            }
+        }
+    }
+
+    // The two shortest edges of the special city
+    double shortest = INF, second = INF;
+    int a = -1, b = -1;
+    for (int v = 0; v < n; v++) {
+        if (v == special) continue;
+        double d = distance(special, v) + pi[special] + pi[v];
+        if (d < shortest) {
+            second = shortest;
+            b = a;
+            shortest = d;
+            a = v;
+        } else if (d < second) {
+            second = d;
+            b = v;
+        }
+    }
+    degree[special] = 2;
+    degree[a]++;
+    degree[b]++;
+    return cost + shortest + second;
+}
+
+double OneTreeBound::nearest_neighbour_tour() const {
+    std::vector<char> visited(n, 0);
+    int current = 0;
+    visited[0] = 1;
+    double length = 0.0;
+    for (int step = 1; step < n; step++) {
+        int next = -1;
+        for (int v = 0; v < n; v++) {
+            if (!visited[v] && (next < 0 || adj_mat[current][v] < adj_mat[current][next])) next = v;
+        }
+        length += adj_mat[current][next];
+        visited[next] = 1;
+        current = next;
+    }
+    return length + adj_mat[current][0];
+}
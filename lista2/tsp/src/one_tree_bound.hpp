@@ -0,0 +1,66 @@
+#pragma once
+#include <mpi.h>
+
+#include <vector>
+
+#include "shared_matrix.hpp"
+
+/**
+ * Held-Karp lower bound of the tour length from 1-trees.
+ * A 1-tree is a minimum spanning tree of the cities but a special one, plus the two shortest edges of the special city,
+ * every tour is a 1-tree so its cost is a lower bound. Node penalties pi added to the edges (c_ij + pi_i + pi_j)
+ * do not change the optimal tour and are raised by subgradient optimization on the cities of degree other than 2,
+ * which tightens the bound L(pi) = 1-tree(pi) - 2 * sum(pi).
+ *
+ * The spanning trees are built by Prim's algorithm on the complete graph, O(n^2) per iteration.
+ * Every process uses a different special city and the best bound of all processes is taken.
+ * Asymmetric instances are bounded through the symmetric instance with the shorter direction of every edge.
+ */
+class OneTreeBound {
+   public:
+    /**
+     * @param adj_mat adjacency matrix
+     * @param comm communicator of the processes computing the bound
+     */
+    OneTreeBound(MatrixView<double> adj_mat, MPI_Comm comm = MPI_COMM_WORLD);
+
+    /**
+     * Compute the bound, collective over the communicator
+     * @param max_iter maximal number of subgradient iterations
+     * @return the best lower bound of all processes
+     */
+    double compute(int max_iter);
+
+    /**
+     * The 1-tree of the best bound was a tour, so the bound is the optimal tour length
+     */
+    bool is_tour() const { return tour; }
+
+   private:
+    MatrixView<double> adj_mat;
+    MPI_Comm comm;
+    int rank;
+    int num_procs;
+    int n;
+    bool tour = false;
+
+    std::vector<double> pi;   // Node penalties
+    std::vector<int> degree;  // Degrees of the cities in the last 1-tree
+    std::vector<double> key;  // Buffers of Prim's algorithm
+    std::vector<int> parent;
+    std::vector<char> in_tree;
+
+    double distance(int i, int j) const;
+
+    /**
+     * Build the 1-tree with the current penalties and count the degrees
+     * @param special the special city
+     * @return the cost of the 1-tree with the penalties
+     */
+    double one_tree(int special);
+
+    /**
+     * Length of the nearest neighbour tour from city 0, the upper bound of the step size
+     */
+    double nearest_neighbour_tour() const;
+};
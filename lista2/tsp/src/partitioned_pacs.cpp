@@ -0,0 +1,217 @@
+#include "partitioned_pacs.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+PartitionedPACS::PartitionedPACS(const std::vector<Point> &cities, double beta, double rho, double theta, double q, double tau, MPI_Comm comm)
+    : cities(cities), BETA(beta), RHO(rho), THETA(theta), Q(q), TAU(tau), comm(comm), n(cities.size()) {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+}
+
+void PartitionedPACS::set_rounding(DistanceRounding rounding) {
+    this->rounding = rounding;
+}
+
+void PartitionedPACS::set_seed(unsigned seed) {
+    this->seed = seed + rank;
+    seeded = true;
+}
+
+void PartitionedPACS::set_repair_rounds(int rounds) {
+    repair_rounds = std::max(0, rounds);
+}
+
+double PartitionedPACS::distance(int i, int j) const {
+    double d = hypot(cities[i].x - cities[j].x, cities[i].y - cities[j].y);
+    switch (rounding) {
+        case DistanceRounding::NEAREST:
+            return floor(d + 0.5);
+        case DistanceRounding::CEIL:
+            return ceil(d);
+        default:
+            return d;
+    }
+}
+
+std::pair<double, Path> PartitionedPACS::run(int num_ants, int num_iter, double timeout) {
+    order_cities();
+    std::vector<int> counts(num_procs), displs(num_procs);
+    for (int p = 0; p < num_procs; p++) {
+        displs[p] = region_begin[p];
+        counts[p] = region_begin[p + 1] - region_begin[p];
+    }
+
+    // Every colony solves its region, the sub-tours are joined on rank 0
+    std::vector<int> sub_tour = solve_region(num_ants, num_iter, timeout);
+    std::vector<int> tour(rank == 0 ? n : 0);
+    MPI_Gatherv(sub_tour.data(), sub_tour.size(), MPI_INT, tour.data(), counts.data(), displs.data(), MPI_INT, 0, comm);
+    if (rank == 0) {
+        tour = stitch(tour);
+    }
+
+    // 2-opt on blocks of the tour, shifted by half a region in every round, so the blocks alternate between
+    // blocks centred on the junctions (even rounds) and blocks aligned with the regions (odd rounds)
+    std::vector<int> block;
+    for (int round = 0; round < repair_rounds && n > 3; round++) {
+        if (rank == 0) {
+            std::rotate(tour.begin(), tour.begin() + counts[0] / 2, tour.end());
+        }
+        block.resize(counts[rank]);
+        MPI_Scatterv(tour.data(), counts.data(), displs.data(), MPI_INT, block.data(), block.size(), MPI_INT, 0, comm);
+        two_opt(block);
+        MPI_Gatherv(block.data(), block.size(), MPI_INT, tour.data(), counts.data(), displs.data(), MPI_INT, 0, comm);
+    }
+
+    double length = 0.0;
+    Path path;
+    if (rank == 0) {
+        auto start = std::find(tour.begin(), tour.end(), 0);
+        path.assign(start, tour.end());
+        path.insert(path.end(), tour.begin(), start);
+        path.push_back(0);
+        for (size_t i = 1; i < path.size(); i++) {
+            length += distance(path[i - 1], path[i]);
+        }
+    }
+    MPI_Bcast(&length, 1, MPI_DOUBLE, 0, comm);
+    return {length, path};
+}
+
+void PartitionedPACS::order_cities() {
+    double min_x = std::numeric_limits<double>::max(), min_y = min_x;
+    double max_x = std::numeric_limits<double>::lowest(), max_y = max_x;
+    for (const Point &city : cities) {
+        min_x = std::min(min_x, city.x);
+        max_x = std::max(max_x, city.x);
+        min_y = std::min(min_y, city.y);
+        max_y = std::max(max_y, city.y);
+    }
+    // Same scale on both axes, so the regions are not stretched along the longer side
+    double scale = 65535.0 / std::max({max_x - min_x, max_y - min_y, 1e-12});
+
+    std::vector<uint64_t> keys(n);
+    for (int i = 0; i < n; i++) {
+        keys[i] = hilbert_index((cities[i].x - min_x) * scale, (cities[i].y - min_y) * scale);
+    }
+    order.resize(n);
+    for (int i = 0; i < n; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] != keys[b] ? keys[a] < keys[b] : a < b; });
+
+    region_begin.resize(num_procs + 1);
+    for (int p = 0; p <= num_procs; p++) {
+        region_begin[p] = (size_t)n * p / num_procs;
+    }
+}
+
+std::vector<int> PartitionedPACS::solve_region(int num_ants, int num_iter, double timeout) {
+    std::vector<int> region(order.begin() + region_begin[rank], order.begin() + region_begin[rank + 1]);
+    int m = region.size();
+    if (m <= 3) {
+        return region;  // Every order of up to 3 cities is the same cycle
+    }
+
+    std::vector<double> local((size_t)m * m);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < m; j++) {
+            local[(size_t)i * m + j] = distance(region[i], region[j]);
+        }
+    }
+    MPI_PACS pacs = MPI_PACS(BETA, RHO, THETA, Q, TAU, MPI_COMM_SELF);
+    pacs.set_adj_mat(MatrixView<double>(local.data(), m, m));
+    pacs.set_pheromones(Matrix(m, std::vector<double>(m, 1.0)));
+    if (seeded) {
+        pacs.set_seed(seed);
+    }
+    Path path = pacs.run(num_ants, num_iter, m, num_iter, timeout).second;
+    if (path.size() < (size_t)m) {
+        return region;  // No iteration within the time limit
+    }
+
+    std::vector<int> sub_tour(m);
+    for (int i = 0; i < m; i++) {
+        sub_tour[i] = region[path[i]];
+    }
+    return sub_tour;
+}
+
+std::vector<int> PartitionedPACS::stitch(const std::vector<int> &sub_tours) const {
+    std::vector<int> tour;
+    tour.reserve(n);
+    for (int p = 0; p < num_procs; p++) {
+        const int *cycle = sub_tours.data() + region_begin[p];
+        int m = region_begin[p + 1] - region_begin[p];
+        if (m == 0) continue;
+
+        // Remove the edge (cycle[k], cycle[k + 1]) and walk the cycle from one of its ends,
+        // the first region is opened at its longest edge, the others at the cheapest join to the previous city
+        int best_k = 0;
+        bool forward = true;
+        double best = std::numeric_limits<double>::max();
+        for (int k = 0; k < m; k++) {
+            int a = cycle[k], b = cycle[(k + 1) % m];
+            if (tour.empty()) {
+                if (-distance(a, b) < best) {
+                    best = -distance(a, b);
+                    best_k = k;
+                }
+                continue;
+            }
+            double from_b = distance(tour.back(), b) - distance(a, b);
+            double from_a = distance(tour.back(), a) - distance(a, b);
+            if (from_b < best) {
+                best = from_b;
+                best_k = k;
+                forward = true;
+            }
+            if (from_a < best) {
+                best = from_a;
+                best_k = k;
+                forward = false;
+            }
+        }
+        for (int i = 1; i <= m; i++) {
+            tour.push_back(forward ? cycle[(best_k + i) % m] : cycle[((best_k - i + 1) % m + m) % m]);
+        }
+    }
+    return tour;
+}
+
+void PartitionedPACS::two_opt(std::vector<int> &block) const {
+    int size = block.size();
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (int i = 1; i < size - 2; i++) {
+            for (int j = i + 1; j < size - 1; j++) {
+                // Reverse block[i..j], replacing the edges (i - 1, i) and (j, j + 1)
+                double delta = distance(block[i - 1], block[j]) + distance(block[i], block[j + 1]) - distance(block[i - 1], block[i]) - distance(block[j], block[j + 1]);
+                if (delta < -1e-9) {
+                    std::reverse(block.begin() + i, block.begin() + j + 1);
+                    improved = true;
+                }
+            }
+        }
+    }
+}
+
+uint64_t PartitionedPACS::hilbert_index(uint32_t x, uint32_t y) {
+    const uint32_t side = 1 << 16;
+    uint64_t index = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        index += (uint64_t)s * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so that the curve inside it has the base orientation
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
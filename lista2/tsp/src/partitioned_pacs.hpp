@@ -0,0 +1,121 @@
+#pragma once
+#include <mpi.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "mpi_pacs.hpp"
+
+// City of a coordinate instance
+struct Point {
+    double x;
+    double y;
+};
+
+/**
+ * Rounding of the Euclidean distances, as the EDGE_WEIGHT_TYPE of TSPLIB
+ * @param NONE: exact distances
+ * @param NEAREST: EUC_2D, rounded to the nearest integer
+ * @param CEIL: CEIL_2D, rounded up
+ */
+enum class DistanceRounding {
+    NONE = 0,
+    NEAREST = 1,
+    CEIL = 2,
+};
+
+/**
+ * Ant colonies on a geometric decomposition of a coordinate instance.
+ * The cities are sorted along a Hilbert curve and the curve is cut into one region of n / p consecutive cities
+ * per process, so the regions are compact and neighbouring regions follow each other. Every process runs a colony
+ * on its region only, the sub-tours are gathered and stitched in the order of the regions, opening every sub-tour
+ * at the edge that joins the previous region best. The junctions are repaired by 2-opt in parallel: the tour is cut
+ * into blocks centred on the junctions, every process improves one block with its ends fixed, and the next round
+ * uses the blocks of the regions again.
+ * Every process stores the coordinates and the distances of its region, O(n + (n / p)^2) memory
+ * instead of the n^2 adjacency matrix of MPI_PACS.
+ */
+class PartitionedPACS {
+   public:
+    /**
+     * @param cities coordinates of the cities, the same on all processes, not copied and must outlive the solver
+     * @param beta, rho, theta, q, tau parameters of the colonies, as for MPI_PACS
+     * @param comm communicator of the processes, one region per process
+     */
+    PartitionedPACS(const std::vector<Point> &cities, double beta, double rho, double theta, double q, double tau, MPI_Comm comm = MPI_COMM_WORLD);
+
+    /**
+     * Set the rounding of the distances, exact by default
+     */
+    void set_rounding(DistanceRounding rounding);
+
+    /**
+     * Seed the random choices of the colonies, a random seed is used by default
+     * @param seed the seed, the rank is added so that the colonies differ
+     */
+    void set_seed(unsigned seed);
+
+    /**
+     * Set the number of 2-opt rounds after the stitching, 2 by default.
+     * Every round shifts the blocks by half a region: even rounds repair the junctions of the regions,
+     * odd rounds the regions themselves.
+     */
+    void set_repair_rounds(int rounds);
+
+    /**
+     * Run the colonies on the regions, stitch and repair the tour, collective over the communicator
+     * @param num_ants number of ants of every colony
+     * @param num_iter number of iterations of every colony
+     * @param timeout maximum time of the colonies in seconds
+     * @return the length of the tour on all processes and the tour on rank 0
+     */
+    std::pair<double, Path> run(int num_ants, int num_iter, double timeout);
+
+    /**
+     * Distance between two cities with the rounding of the instance
+     */
+    double distance(int i, int j) const;
+
+   private:
+    const std::vector<Point> &cities;
+    double BETA, RHO, THETA, Q, TAU;  // Parameters of the colonies
+    MPI_Comm comm;
+    int rank;
+    int num_procs;
+    int n;
+    bool seeded = false;
+    unsigned seed = 0;
+    int repair_rounds = 2;
+    DistanceRounding rounding = DistanceRounding::NONE;
+
+    std::vector<int> order;         // Cities sorted along the Hilbert curve
+    std::vector<int> region_begin;  // Position of the first city of every region in order
+
+    /**
+     * Sort the cities along the Hilbert curve of the bounding box
+     */
+    void order_cities();
+
+    /**
+     * Run the colony of the region of this process
+     * @return the sub-tour, a cycle of the cities of the region without the repeated first city
+     */
+    std::vector<int> solve_region(int num_ants, int num_iter, double timeout);
+
+    /**
+     * Join the sub-tours in the order of the regions
+     * @param sub_tours the sub-tours of all regions, one after another
+     */
+    std::vector<int> stitch(const std::vector<int> &sub_tours) const;
+
+    /**
+     * 2-opt on a part of the tour until no move improves it, the first and the last city stay in place
+     */
+    void two_opt(std::vector<int> &block) const;
+
+    /**
+     * Index of the point on the Hilbert curve of a 2^16 x 2^16 grid
+     */
+    static uint64_t hilbert_index(uint32_t x, uint32_t y);
+};
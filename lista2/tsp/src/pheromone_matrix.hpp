@@ -0,0 +1,153 @@
+#pragma once
+#include <mpi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Rounding of the values stored in fixed point
+ * @param NEAREST: round to the nearest step
+ * @param STOCHASTIC: round up with the probability of the distance to the lower step, unbiased on average,
+ *                    so updates smaller than a step are not lost
+ */
+enum class PheromoneRounding {
+    NEAREST = 0,
+    STOCHASTIC = 1,
+};
+
+/**
+ * Storage types of the pheromone table
+ * double and float store the values as they are (float rounds to the nearest float),
+ * uint16_t stores fixed point steps of max_value / 65535, larger values saturate.
+ * choice_type is the type of the choice table (pheromone times heuristic), the distance powers
+ * span too many orders of magnitude for fixed point, so it stays float.
+ */
+template <typename T>
+struct PheromoneTraits;
+
+template <>
+struct PheromoneTraits<double> {
+    typedef double choice_type;
+    static constexpr bool fixed_point = false;
+    static MPI_Datatype mpi_type() { return MPI_DOUBLE; }
+};
+
+template <>
+struct PheromoneTraits<float> {
+    typedef float choice_type;
+    static constexpr bool fixed_point = false;
+    static MPI_Datatype mpi_type() { return MPI_FLOAT; }
+};
+
+template <>
+struct PheromoneTraits<uint16_t> {
+    typedef float choice_type;
+    static constexpr bool fixed_point = true;
+    static MPI_Datatype mpi_type() { return MPI_UINT16_T; }
+};
+
+/**
+ * Pheromone table of the colony.
+ * For symmetric instances only the lower triangle is stored (n(n+1)/2 values),
+ * an update of edge (i, j) is then also seen on edge (j, i).
+ * The values are kept in one contiguous array of T so the whole table can be sent with a single message
+ * in its compact form, 8, 4 or 2 bytes per value.
+ */
+template <typename T = double>
+class PheromoneMatrix {
+   public:
+    typedef PheromoneTraits<T> Traits;
+
+    PheromoneMatrix() {}
+
+    /**
+     * Constructor
+     * @param n number of cities
+     * @param symmetric store only the lower triangle
+     * @param initial initial pheromone level
+     * @param max_value largest value of a fixed point table, ignored for floating point
+     * @param rounding rounding of a fixed point table
+     */
+    PheromoneMatrix(int n, bool symmetric, double initial, double max_value = 1.0, PheromoneRounding rounding = PheromoneRounding::NEAREST)
+        : n(n), symmetric(symmetric), step(max_value / 65535), rounding(rounding) {
+        values.assign(symmetric ? (size_t)n * (n + 1) / 2 : (size_t)n * n, encode(initial));
+    }
+
+    double operator()(int i, int j) const { return decode(values[index(i, j)]); }
+
+    void set(int i, int j, double value) { values[index(i, j)] = encode(value); }
+
+    /**
+     * Value at a position of the storage
+     */
+    double at(size_t position) const { return decode(values[position]); }
+
+    void store(size_t position, double value) { values[position] = encode(value); }
+
+    /**
+     * Position of edge (i, j) in the storage
+     */
+    size_t index(int i, int j) const {
+        if (!symmetric) {
+            return (size_t)i * n + j;
+        }
+        if (i < j) {
+            std::swap(i, j);
+        }
+        return (size_t)i * (i + 1) / 2 + j;
+    }
+
+    int num_cities() const { return n; }
+
+    bool is_symmetric() const { return symmetric; }
+
+    // Number of stored values
+    size_t storage_size() const { return values.size(); }
+
+    T *data() { return values.data(); }
+
+    const T *data() const { return values.data(); }
+
+    static MPI_Datatype mpi_type() { return Traits::mpi_type(); }
+
+    /**
+     * Exchange the values with a buffer of storage_size() values, used to swap in received tables without copying
+     */
+    void swap(std::vector<T> &other) { values.swap(other); }
+
+   private:
+    int n = 0;
+    bool symmetric = false;
+    double step = 1.0;  // Value of one fixed point step
+    PheromoneRounding rounding = PheromoneRounding::NEAREST;
+    uint64_t rounding_state = 0x9E3779B97F4A7C15ull;  // xorshift state of the stochastic rounding
+    std::vector<T> values;
+
+    double decode(T value) const {
+        if constexpr (Traits::fixed_point) {
+            return value * step;
+        } else {
+            return value;
+        }
+    }
+
+    T encode(double value) {
+        if constexpr (Traits::fixed_point) {
+            double steps = value / step;
+            if (rounding == PheromoneRounding::STOCHASTIC) {
+                rounding_state ^= rounding_state << 13;
+                rounding_state ^= rounding_state >> 7;
+                rounding_state ^= rounding_state << 17;
+                steps = std::floor(steps + (rounding_state >> 11) * 0x1.0p-53);
+            } else {
+                steps = std::floor(steps + 0.5);
+            }
+            return (T)std::clamp(steps, 0.0, 65535.0);
+        } else {
+            return (T)value;
+        }
+    }
+};
@@ -1,5 +1,8 @@
 #include <random>
 
+#ifndef RNG_HPP
+#define RNG_HPP
+
 class IntRNG {
    public:
     IntRNG(int min, int max) {
@@ -8,6 +11,11 @@ class IntRNG {
         dist = std::uniform_int_distribution<int>(min, max);
     }
 
+    IntRNG(int min, int max, unsigned seed) {
+        gen = std::mt19937(seed);
+        dist = std::uniform_int_distribution<int>(min, max);
+    }
+
     int getNext() {
         return dist(gen);
     }
@@ -25,6 +33,11 @@ class DoubleRNG {
         dist = std::uniform_real_distribution<double>(min, max);
     }
 
+    DoubleRNG(double min, double max, unsigned seed) {
+        gen = std::mt19937(seed);
+        dist = std::uniform_real_distribution<double>(min, max);
+    }
+
     double getNext() {
         return dist(gen);
     }
@@ -32,4 +45,6 @@ class DoubleRNG {
    private:
     std::mt19937 gen;
     std::uniform_real_distribution<double> dist;
-};
\ No newline at end of file
+};
+
+#endif
\ No newline at end of file
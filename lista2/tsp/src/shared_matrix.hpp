@@ -0,0 +1,127 @@
+#pragma once
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+/**
+ * Read-only view of a row-major matrix, does not own the data
+ */
+template <typename T>
+class MatrixView {
+   public:
+    MatrixView() {}
+    MatrixView(const T *data, int rows, int cols) : ptr(data), rows(rows), cols(cols) {}
+
+    const T *operator[](int row) const { return ptr + (size_t)row * cols; }
+
+    // Number of rows
+    int size() const { return rows; }
+
+    int num_cols() const { return cols; }
+
+    const T *data() const { return ptr; }
+
+   private:
+    const T *ptr = nullptr;
+    int rows = 0;
+    int cols = 0;
+};
+
+typedef MatrixView<int> IntMatrixView;
+
+/**
+ * Matrix stored once per node in an MPI-3 shared memory window.
+ * All processes of a node read the same memory, so the memory used for the instance
+ * does not grow with the number of processes.
+ * The constructor, distribute and release are collective over the communicator.
+ */
+template <typename T>
+class SharedMatrix {
+   public:
+    /**
+     * Allocate the matrix, only the first process of every node allocates the memory
+     * @param rows number of rows
+     * @param cols number of columns
+     * @param comm the processes sharing the matrix
+     */
+    SharedMatrix(int rows, int cols, MPI_Comm comm = MPI_COMM_WORLD) : rows(rows), cols(cols), comm(comm) {
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+        int node_rank;
+        MPI_Comm_rank(node_comm, &node_rank);
+        // Communicator of the first processes of all the nodes, used to copy the matrix between the nodes
+        MPI_Comm_split(comm, node_rank == 0 ? 0 : MPI_UNDEFINED, 0, &leaders_comm);
+
+        MPI_Aint bytes = node_rank == 0 ? (MPI_Aint)rows * cols * sizeof(T) : 0;
+        T *local;
+        MPI_Win_allocate_shared(bytes, sizeof(T), MPI_INFO_NULL, node_comm, &local, &win);
+        MPI_Aint size;
+        int disp_unit;
+        MPI_Win_shared_query(win, 0, &size, &disp_unit, &base);
+    }
+
+    SharedMatrix(const SharedMatrix &) = delete;
+    SharedMatrix &operator=(const SharedMatrix &) = delete;
+
+    ~SharedMatrix() {
+        int finalized;
+        MPI_Finalized(&finalized);
+        if (!finalized) {
+            release();
+        }
+    }
+
+    /**
+     * Copy the matrix read by rank 0 of the communicator to the shared memory of every node
+     * @param source the matrix, only used on rank 0
+     */
+    void distribute(const std::vector<std::vector<T>> &source) {
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Win_fence(0, win);
+        if (rank == 0) {
+            for (int i = 0; i < rows; i++) {
+                std::memcpy(base + (size_t)i * cols, source[i].data(), cols * sizeof(T));
+            }
+        }
+        if (leaders_comm != MPI_COMM_NULL) {
+            // Broadcast in chunks, the count of a single call is an int
+            size_t total = (size_t)rows * cols * sizeof(T);
+            const size_t chunk = 1 << 30;
+            for (size_t offset = 0; offset < total; offset += chunk) {
+                MPI_Bcast((char *)base + offset, std::min(chunk, total - offset), MPI_BYTE, 0, leaders_comm);
+            }
+        }
+        MPI_Win_fence(0, win);
+    }
+
+    /**
+     * Get the read-only view of the matrix, valid until release
+     */
+    MatrixView<T> view() const { return MatrixView<T>(base, rows, cols); }
+
+    /**
+     * Free the shared memory, must be called before MPI_Finalize
+     */
+    void release() {
+        if (win != MPI_WIN_NULL) {
+            MPI_Win_free(&win);
+        }
+        if (leaders_comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&leaders_comm);
+        }
+        if (node_comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&node_comm);
+        }
+    }
+
+   private:
+    int rows;
+    int cols;
+    MPI_Comm comm;
+    T *base = nullptr;
+    MPI_Win win = MPI_WIN_NULL;
+    MPI_Comm node_comm = MPI_COMM_NULL;
+    MPI_Comm leaders_comm = MPI_COMM_NULL;
+};
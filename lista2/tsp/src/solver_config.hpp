@@ -0,0 +1,154 @@
+#pragma once
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Run configuration of a solver, read from the command line and an optional config file.
+ * Options are given as --key value or --key=value, an option without a value is a flag set to true.
+ * The boolean flags named in the constructor take a value only as --flag=value, so a positional argument after them stays one.
+ * --config <file> reads "key = value" lines (# starts a comment), the command line takes precedence over the file.
+ * Arguments not starting with -- are kept as positional arguments.
+ */
+class SolverConfig {
+   public:
+    /**
+     * @param argc the number of arguments
+     * @param argv the arguments
+     * @param flags the boolean options of the program, e.g. {"print-config"}
+     */
+    SolverConfig(int argc, char **argv, const std::set<std::string> &flags = {}) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                args.push_back(arg);
+                continue;
+            }
+            std::string key = arg.substr(2), value = "true";
+            size_t eq = key.find('=');
+            if (eq != std::string::npos) {
+                value = key.substr(eq + 1);
+                key = key.substr(0, eq);
+            } else if (!flags.count(key) && i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+                value = argv[++i];
+            }
+            values[key] = value;
+        }
+        if (values.count("config")) {
+            read_file(values.at("config"));
+        }
+    }
+
+    bool has(const std::string &key) const { return values.count(key) > 0; }
+
+    std::string get_string(const std::string &key, const std::string &default_value) const { return lookup(key, default_value); }
+
+    int get_int(const std::string &key, int default_value) const {
+        return std::stoi(lookup(key, std::to_string(default_value)));
+    }
+
+    double get_double(const std::string &key, double default_value) const {
+        std::ostringstream text;
+        text << default_value;
+        return std::stod(lookup(key, text.str()));
+    }
+
+    bool get_bool(const std::string &key, bool default_value) const {
+        std::string value = lookup(key, default_value ? "true" : "false");
+        return value == "true" || value == "1" || value == "yes";
+    }
+
+    const std::vector<std::string> &positional() const { return args; }
+
+    /**
+     * Get a positional argument
+     * @param index index among the positional arguments
+     * @param default_value returned if there are fewer positional arguments
+     */
+    std::string positional(size_t index, const std::string &default_value) const { return index < args.size() ? args[index] : default_value; }
+
+    /**
+     * Options that were given but never read, usually typos
+     */
+    std::vector<std::string> unused() const {
+        std::vector<std::string> keys;
+        for (auto &[key, value] : values) {
+            if (!used.count(key) && key != "config") keys.push_back(key);
+        }
+        return keys;
+    }
+
+    /**
+     * Print the options read so far with the values in effect, in the config file format
+     * so that the output can be used as the config file of another run
+     */
+    void print(std::ostream &out) const {
+        for (auto &[key, value] : used) {
+            out << key << " = " << value << std::endl;
+        }
+        for (const std::string &key : unused()) {
+            out << "# unknown option " << key << std::endl;
+        }
+    }
+
+   private:
+    std::map<std::string, std::string> values;
+    std::vector<std::string> args;
+    mutable std::map<std::string, std::string> used;  // Options read and the values in effect
+
+    std::string lookup(const std::string &key, const std::string &default_value) const {
+        auto it = values.find(key);
+        std::string value = it != values.end() ? it->second : default_value;
+        used[key] = value;
+        return value;
+    }
+
+    void read_file(const std::string &filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open config file " + filename);
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            size_t eq = line.find('=');
+            if (eq == std::string::npos) {
+                continue;
+            }
+            std::string key = trim(line.substr(0, eq)), value = trim(line.substr(eq + 1));
+            if (!key.empty() && !values.count(key)) {
+                values[key] = value;
+            }
+        }
+    }
+
+    static std::string trim(const std::string &text) {
+        size_t first = text.find_first_not_of(" \t\r");
+        size_t last = text.find_last_not_of(" \t\r");
+        return first == std::string::npos ? "" : text.substr(first, last - first + 1);
+    }
+};
+
+/**
+ * Read the leading integers of a data file, e.g. the dimensions of an instance
+ * @param filename the data file
+ * @param count number of integers to read
+ */
+inline std::vector<int> read_dimensions(const std::string &filename, int count) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file " + filename);
+    }
+    std::vector<int> dimensions(count);
+    for (int &dimension : dimensions) {
+        if (!(file >> dimension)) {
+            throw std::runtime_error("Could not read the dimensions of " + filename);
+        }
+    }
+    return dimensions;
+}
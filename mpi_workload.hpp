@@ -0,0 +1,68 @@
+#pragma once
+#include <mpi.h>
+
+#include <string>
+#include <vector>
+
+#include "workload.hpp"
+
+// Tag of the message a worker sends to the coordinator after its last operation
+#define TERMINATE_TAG 99
+
+/**
+ * Notify the coordinator that this worker has finished all of its operations
+ * @param coordinator rank of the coordinator
+ */
+inline void send_termination(int coordinator) {
+    int buffer_out = 0;
+    MPI_Send(&buffer_out, 1, MPI_INT, coordinator, TERMINATE_TAG, MPI_COMM_WORLD);
+}
+
+/**
+ * Gather the latency samples of all processes on the root.
+ * Processes that did not measure anything (e.g. the coordinator) pass empty stats.
+ *
+ * @param local the stats of this process
+ * @param root rank receiving the merged stats
+ * @return merged stats on the root, empty stats elsewhere
+ */
+inline LatencyStats gather_stats(const LatencyStats &local, int root) {
+    int rank;
+    int num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    int count = local.data().size();
+    std::vector<int> counts(num_procs);
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, root, MPI_COMM_WORLD);
+
+    std::vector<int> displs(num_procs, 0);
+    for (int i = 1; i < num_procs; i++) {
+        displs[i] = displs[i - 1] + counts[i - 1];
+    }
+
+    LatencyStats merged;
+    if (rank == root) {
+        merged.data().resize(displs[num_procs - 1] + counts[num_procs - 1]);
+    }
+    MPI_Gatherv(local.data().data(), count, MPI_DOUBLE, merged.data().data(), counts.data(), displs.data(), MPI_DOUBLE, root, MPI_COMM_WORLD);
+    return merged;
+}
+
+/**
+ * Gather the stats on the root and print them there
+ * @param local the stats of this process
+ * @param elapsed wall time of this process in seconds, the maximum over all processes is reported
+ * @param label name of the measured operation
+ * @param root rank printing the report
+ */
+inline void report_stats(const LatencyStats &local, double elapsed, const std::string &label, int root) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    LatencyStats merged = gather_stats(local, root);
+    double max_elapsed;
+    MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, root, MPI_COMM_WORLD);
+    if (rank == root) {
+        merged.report(label, max_elapsed);
+    }
+}
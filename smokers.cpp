@@ -2,50 +2,76 @@
 #include <thread>
 #include <mutex>
 #include <chrono>
+#include <vector>
 #include <semaphore.h>
 
-const int k = 10;  // liczba palaczy
-const int l = 4;  // liczba ubijaczy
-const int m = 3;  // liczba pudełek zapałek
+#include "workload.hpp"
+
+int k = 10;  // liczba palaczy
+int l = 4;  // liczba ubijaczy
+int m = 3;  // liczba pudełek zapałek
 
 sem_t fillers;
 sem_t matchbox;
 std::mutex coutMutex;
+std::mutex statsMutex;
+
+WorkloadConfig config;
+LatencyStats fillerStats;
+LatencyStats matchboxStats;
 
 void message(const std::string& msg) {
+    if (!config.verbose) return;
     coutMutex.lock();
     std::cout << msg << std::endl;
     coutMutex.unlock();
 }
 
 void smoker(int id) {
-    while (true) {
+    Workload fillerWorkload(config, id);
+    Workload matchboxWorkload(config, k + id);
+    while (fillerWorkload.next()) {
         message("Palacz " + std::to_string(id) + " czeka na ubijacza.");
+        fillerWorkload.begin();
         sem_wait(&fillers);
+        fillerWorkload.end();
 
         message("Palacz " + std::to_string(id) + " używa ubijacza.");
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        fillerWorkload.work();
         message("Palacz " + std::to_string(id) + " oddaje ubijacz.");
 
         sem_post(&fillers);
-        
+
         message("Palacz " + std::to_string(id) + " czeka na pudełko zapałek.");
+        matchboxWorkload.begin();
         sem_wait(&matchbox);
+        matchboxWorkload.end();
         message("Palacz " + std::to_string(id) + " zapala fajkę.");
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        matchboxWorkload.work();
         message("Palacz " + std::to_string(id) + " oddaje pudełko zapałek.");
         sem_post(&matchbox);
-        
+
         message("Palacz " + std::to_string(id) + " pali fajkę.");
-        std::this_thread::sleep_for(std::chrono::seconds(2));
+        fillerWorkload.think();
     }
+
+    statsMutex.lock();
+    fillerStats.merge(fillerWorkload.stats);
+    matchboxStats.merge(matchboxWorkload.stats);
+    statsMutex.unlock();
 }
 
-int main() {
+int main(int argc, char** argv) {
+    parse_workload_args(argc, argv, config, {{"--smokers", &k}, {"--fillers", &l}, {"--matchboxes", &m}});
+    if (k < 1 || l < 1 || m < 1) {
+        throw std::runtime_error("At least 1 smoker, 1 filler and 1 matchbox are needed");
+    }
+
     sem_init(&fillers, 0, l);
     sem_init(&matchbox, 0, m);
 
-    std::thread smokers[k];
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> smokers(k);
     for (int i = 0; i < k; ++i) {
         smokers[i] = std::thread(smoker, i);
     }
@@ -53,9 +79,13 @@ int main() {
     for (int i = 0; i < k; ++i) {
         smokers[i].join();
     }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
     sem_destroy(&fillers);
     sem_destroy(&matchbox);
 
+    fillerStats.report("filler", elapsed);
+    matchboxStats.report("matchbox", elapsed);
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,260 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Delays shorter than this (in microseconds) are busy-waited, sleep_for is too coarse for them
+#define SPIN_THRESHOLD_US 200
+
+/**
+ * Distribution of a think / work delay, all values are in microseconds.
+ * Accepted specs:
+ *  "zero"                      no delay at all
+ *  "const:<us>"                always the same delay
+ *  "uniform:<min_us>:<max_us>" uniformly distributed delay
+ *  "exp:<mean_us>"             exponentially distributed delay
+ */
+class DelayDistribution {
+   public:
+    enum class Kind {
+        ZERO = 0,
+        CONSTANT = 1,
+        UNIFORM = 2,
+        EXPONENTIAL = 3,
+    };
+
+    DelayDistribution(Kind kind = Kind::ZERO, double a = 0.0, double b = 0.0) : kind(kind), a(a), b(b) {}
+
+    /**
+     * Parse the distribution from its textual spec
+     * @param spec the spec, see class description
+     */
+    static DelayDistribution parse(const std::string &spec) {
+        std::vector<std::string> parts;
+        std::stringstream ss(spec);
+        std::string part;
+        while (std::getline(ss, part, ':')) {
+            parts.push_back(part);
+        }
+        if (parts.empty() || parts[0] == "zero") {
+            return DelayDistribution(Kind::ZERO);
+        }
+        if (parts[0] == "const" && parts.size() == 2) {
+            double delay = std::stod(parts[1]);
+            if (delay < 0) {
+                throw std::runtime_error("A constant delay must not be negative: " + spec);
+            }
+            return DelayDistribution(Kind::CONSTANT, delay);
+        }
+        if (parts[0] == "uniform" && parts.size() == 3) {
+            double min = std::stod(parts[1]), max = std::stod(parts[2]);
+            if (min < 0 || min > max) {
+                throw std::runtime_error("A uniform delay needs 0 <= min <= max: " + spec);
+            }
+            return DelayDistribution(Kind::UNIFORM, min, max);
+        }
+        if (parts[0] == "exp" && parts.size() == 2) {
+            double mean = std::stod(parts[1]);
+            if (mean <= 0) {
+                throw std::runtime_error("The mean of an exponential delay must be positive: " + spec);
+            }
+            return DelayDistribution(Kind::EXPONENTIAL, mean);
+        }
+        throw std::runtime_error("Invalid delay distribution: " + spec);
+    }
+
+    /**
+     * Draw a delay
+     * @param gen the random engine of the caller
+     * @return the delay in microseconds
+     */
+    long long sample(std::mt19937_64 &gen) const {
+        switch (kind) {
+            case Kind::ZERO:
+                return 0;
+            case Kind::CONSTANT:
+                return (long long)a;
+            case Kind::UNIFORM:
+                return (long long)std::uniform_real_distribution<double>(a, b)(gen);
+            case Kind::EXPONENTIAL:
+                return (long long)std::exponential_distribution<double>(1.0 / a)(gen);
+            default:
+                throw std::runtime_error("Invalid delay distribution");
+        }
+    }
+
+   private:
+    Kind kind;
+    double a;  // constant / min / mean
+    double b;  // max
+};
+
+/**
+ * Configuration shared by all the workload drivers
+ */
+struct WorkloadConfig {
+    long long num_ops = 1000;     // Number of operations per worker, used when duration is not set
+    double duration = 0.0;        // Run time per worker in seconds, 0 means run num_ops operations
+    DelayDistribution think;      // Delay outside of the critical section
+    DelayDistribution work;       // Delay inside of the critical section
+    unsigned long long seed = 0;  // Base seed, every worker uses seed + its id
+    bool verbose = false;         // Print a message per operation (distorts the timings)
+};
+
+/**
+ * Parse the common workload flags
+ *  --ops <n> --duration <seconds> --think <spec> --work <spec> --seed <n> --verbose
+ * plus any integer flags specific to the demo (e.g. --writers 2).
+ *
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @param config The config return variable
+ * @param int_options demo specific integer flags, the value is written through the pointer
+ */
+inline void parse_workload_args(int argc, char **argv, WorkloadConfig &config, const std::map<std::string, int *> &int_options = {}) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--verbose") {
+            config.verbose = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::runtime_error("Missing value for " + flag);
+        }
+        std::string value = argv[++i];
+        if (flag == "--ops") {
+            config.num_ops = std::stoll(value);
+        } else if (flag == "--duration") {
+            config.duration = std::stod(value);
+        } else if (flag == "--think") {
+            config.think = DelayDistribution::parse(value);
+        } else if (flag == "--work") {
+            config.work = DelayDistribution::parse(value);
+        } else if (flag == "--seed") {
+            config.seed = std::stoull(value);
+        } else if (int_options.count(flag)) {
+            *int_options.at(flag) = std::stoi(value);
+        } else {
+            throw std::runtime_error("Unknown flag " + flag);
+        }
+    }
+}
+
+/**
+ * Latency samples (in microseconds) of the coordination part of each operation
+ */
+class LatencyStats {
+   public:
+    void add(double latency_us) { samples.push_back(latency_us); }
+
+    void merge(const LatencyStats &other) { samples.insert(samples.end(), other.samples.begin(), other.samples.end()); }
+
+    std::vector<double> &data() { return samples; }
+    const std::vector<double> &data() const { return samples; }
+
+    /**
+     * Get the p-th percentile using the nearest rank method
+     * @param p percentile in [0, 100]
+     */
+    double percentile(double p) const {
+        if (samples.empty()) return 0.0;
+        std::vector<double> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        size_t idx = (size_t)std::ceil(p / 100.0 * sorted.size());
+        return sorted[std::min(sorted.size() - 1, idx == 0 ? 0 : idx - 1)];
+    }
+
+    /**
+     * Print throughput and latency percentiles
+     * @param label name of the measured operation
+     * @param elapsed wall time of the run in seconds
+     */
+    void report(const std::string &label, double elapsed) const {
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << label << ": ops=" << samples.size() << " time=" << elapsed << "s"
+                  << " throughput=" << (elapsed > 0 ? samples.size() / elapsed : 0.0) << " ops/s" << std::endl;
+        std::cout << label << " latency[us]: p50=" << percentile(50) << " p90=" << percentile(90)
+                  << " p99=" << percentile(99) << " max=" << percentile(100) << std::endl;
+    }
+
+   private:
+    std::vector<double> samples;
+};
+
+/**
+ * Workload driver of a single worker (MPI process or thread).
+ * Usage:
+ *  while (w.next()) { w.think(); w.begin(); <acquire>; w.end(); w.work(); <release>; }
+ */
+class Workload {
+   public:
+    /**
+     * @param config the shared workload configuration
+     * @param id id of the worker, used to seed the random engine
+     */
+    Workload(const WorkloadConfig &config, int id) : config(config), gen(config.seed + id) {
+        start = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Check if another operation should be executed, counts the operation if so
+     */
+    bool next() {
+        if (config.duration > 0) {
+            return elapsed() < config.duration;
+        }
+        return done_ops++ < config.num_ops;
+    }
+
+    // Delay outside of the critical section
+    void think() { delay(config.think.sample(gen)); }
+
+    // Delay inside of the critical section
+    void work() { delay(config.work.sample(gen)); }
+
+    // Mark the start of the coordination part of the operation
+    void begin() { op_start = std::chrono::steady_clock::now(); }
+
+    // Mark the end of the coordination part of the operation and record its latency
+    void end() {
+        auto now = std::chrono::steady_clock::now();
+        stats.add(std::chrono::duration<double, std::micro>(now - op_start).count());
+    }
+
+    // Time since the worker started in seconds
+    double elapsed() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+
+    std::mt19937_64 &rng() { return gen; }
+
+    bool verbose() const { return config.verbose; }
+
+    LatencyStats stats;
+
+   private:
+    const WorkloadConfig &config;
+    std::mt19937_64 gen;
+    long long done_ops = 0;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point op_start;
+
+    static void delay(long long us) {
+        if (us <= 0) return;
+        if (us < SPIN_THRESHOLD_US) {
+            auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+            while (std::chrono::steady_clock::now() < until) {
+            }
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+};
@@ -1,8 +1,9 @@
 #include <mpi.h> // Import MPI lib
 #include <iostream>
-#include <time.h>
 #include <list>
-#include <unistd.h>
+#include <random>
+
+#include "mpi_workload.hpp"
 
 #define COORDINATOR_RANK 0
 
@@ -10,9 +11,10 @@
 #define READ_TAG 1
 #define SUCCESS_TAG 2
 
-void reader(int);
-void writer(int);
-void coordinator(int);
+void reader(int, Workload&);
+void writer(int, Workload&);
+void coordinator(int, int, int);
+void serve_readers(std::list<int>&, int, int&);
 
 int main(int argc, char** argv) {
     MPI_Init(&argc, &argv); // Initialize the MPI environment
@@ -20,75 +22,108 @@ int main(int argc, char** argv) {
     int rank;
     MPI_Comm_size(MPI_COMM_WORLD, &processes); // Get the number of processes
     MPI_Comm_rank(MPI_COMM_WORLD, &rank); // Get the rank of the process
-    
-    if (rank == 0) {
-        coordinator(rank);
-    } else if (rank < 3) {
-        writer(rank);
+
+    WorkloadConfig config;
+    int num_writers = 2; // ranks 1..num_writers are writers, the rest are readers
+    int max_reads = 3;   // a value can be overwritten once it was read more than max_reads times
+    parse_workload_args(argc, argv, config, {{"--writers", &num_writers}, {"--max-reads", &max_reads}});
+    if (num_writers < 1 || max_reads < 1) {
+        throw std::runtime_error("At least 1 writer and 1 read per value are needed");
+    }
+
+    Workload workload(config, rank);
+    LatencyStats no_stats;
+    if (rank == COORDINATOR_RANK) {
+        coordinator(processes, num_writers, max_reads);
+    } else if (rank <= num_writers) {
+        writer(rank, workload);
     } else {
-        reader(rank);
+        reader(rank, workload);
     }
+    double elapsed = workload.elapsed();
+
+    // Every process takes part in both reductions, only the matching role contributes samples
+    report_stats(rank != COORDINATOR_RANK && rank <= num_writers ? workload.stats : no_stats, elapsed, "write", COORDINATOR_RANK);
+    report_stats(rank > num_writers ? workload.stats : no_stats, elapsed, "read", COORDINATOR_RANK);
 
     MPI_Finalize(); // Finalize the MPI environment.
 }
 
-void coordinator(int rank){
+void coordinator(int processes, int num_writers, int max_reads){
     int val = -1;
-    int r;
     MPI_Status status;
     int num_reads = 0;
     std::list<int> readers_queue;
     int current = -1;
+    int finished = 0;
+    int finished_writers = 0;
 
-    while (true) {
+    while (finished < processes - 1) {
         MPI_Recv(&val, 1, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
-        if (status.MPI_TAG == WRITE_TAG) {
-            if (num_reads > 3 || current == -1) {
+        if (status.MPI_TAG == TERMINATE_TAG) {
+            finished++;
+            if (status.MPI_SOURCE <= num_writers) {
+                finished_writers++;
+            }
+            if (finished_writers == num_writers) {
+                // Nothing will be written anymore, release readers still waiting for the first value
+                serve_readers(readers_queue, current, num_reads);
+            }
+        } else if (status.MPI_TAG == WRITE_TAG) {
+            if (num_reads > max_reads || current == -1) {
                 current = val;
                 num_reads = 0;
-                std::cout << "Writer " << status.MPI_SOURCE << " wrote " << val << std::endl;
             }
         } else {
-            if (current == -1){
-                readers_queue.push_back(status.MPI_SOURCE);
-            } else {
-                MPI_Send(&current, 1, MPI_INT, status.MPI_SOURCE, SUCCESS_TAG, MPI_COMM_WORLD);
-                num_reads++;
-            }
-            if (!readers_queue.empty() && current != -1) {
-                for (std::list<int>::iterator it = readers_queue.begin(); it != readers_queue.end(); it++){
-                        r = *it;
-                        MPI_Send(&current, 1, MPI_INT, r, SUCCESS_TAG, MPI_COMM_WORLD);
-                        num_reads++;
-                        it = readers_queue.erase(it);
-                    }
-                }
-            }
+            readers_queue.push_back(status.MPI_SOURCE);
+        }
+        if (current != -1 || finished_writers == num_writers) {
+            serve_readers(readers_queue, current, num_reads);
         }
     }
+}
+
+/**
+ * Send the current value to all waiting readers
+ *
+ * @param readers_queue The waiting readers, emptied by the call
+ * @param current The current value
+ * @param num_reads Number of reads of the current value, updated by the call
+ */
+void serve_readers(std::list<int>& readers_queue, int current, int& num_reads){
+    while (!readers_queue.empty()) {
+        int r = readers_queue.front();
+        MPI_Send(&current, 1, MPI_INT, r, SUCCESS_TAG, MPI_COMM_WORLD);
+        num_reads++;
+        readers_queue.pop_front();
+    }
+}
 
-void writer(int rank) {
-    srand(time(NULL) + rank);
-    int sleep_time;
+void writer(int rank, Workload& workload) {
     int val;
 
-    while (true) {
-        val = rand() % 10;
-        sleep_time = rand() % 10;
-        sleep(sleep_time);
+    while (workload.next()) {
+        val = std::uniform_int_distribution<int>(0, 9)(workload.rng());
+        workload.think();
+        workload.begin();
+        workload.work(); // Write
         MPI_Send(&val, 1, MPI_INT, COORDINATOR_RANK, WRITE_TAG, MPI_COMM_WORLD);
-    }   
+        workload.end();
+        if (workload.verbose()) std::cout << "Writer " << rank << " wrote " << val << std::endl;
+    }
+    send_termination(COORDINATOR_RANK);
 }
 
-void reader(int rank) {
-    srand(time(NULL) + rank);
-    int sleep_time;
+void reader(int rank, Workload& workload) {
     int val;
-    while (true) {
-        sleep_time = rand() % 10;
-        sleep(sleep_time);
+    while (workload.next()) {
+        workload.think();
+        workload.begin();
         MPI_Send(&val, 1, MPI_INT, COORDINATOR_RANK, READ_TAG, MPI_COMM_WORLD);
         MPI_Recv(&val, 1, MPI_INT, COORDINATOR_RANK, SUCCESS_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        std::cout << "Reader " << rank << " is reading " << val << std::endl;
+        workload.end();
+        workload.work(); // Read
+        if (workload.verbose()) std::cout << "Reader " << rank << " is reading " << val << std::endl;
     }
-}
\ No newline at end of file
+    send_termination(COORDINATOR_RANK);
+}